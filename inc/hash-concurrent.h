@@ -0,0 +1,93 @@
+// hash-concurrent.h
+// kpadron.github@gmail.com
+// Kristian Padron
+// thread safe hash table with lock striped writers and lock free readers
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "hash-table.h"
+
+// Writer locks (a power of 2, buckets never number fewer)
+#define HASH_CONCURRENT_STRIPES 64
+
+// Threads that may read a concurrent table without locks at the same time (others lock a stripe)
+#define HASH_CONCURRENT_THREADS 256
+
+// Average chain length that triggers growth (chains are copied on every write)
+#define HASH_CONCURRENT_ALPHA 2
+
+// Retired objects a stripe holds before trying to reclaim them
+#define HASH_CONCURRENT_RETIRE 64
+
+// Object representing an immutable bucket chain replaced whole by writers
+typedef struct
+{
+    uint32_t count;
+    entry_t entries[];
+} hash_chain_t;
+
+// Object representing a bucket array (size is a power of 2)
+typedef struct
+{
+    uint32_t size;
+    hash_chain_t* buckets[];
+} hash_array_t;
+
+// Object representing memory unlinked by a writer at some epoch
+typedef struct
+{
+    void* ptr;
+    void (*free)(void*);
+    uint64_t epoch;
+} hash_retired_t;
+
+// Object representing a writer lock with the memory its writers retired
+typedef struct __attribute__((aligned(64)))
+{
+    pthread_mutex_t lock;
+    hash_retired_t* retired;
+    uint32_t count;
+    uint32_t size;
+} hash_stripe_t;
+
+// Object representing epoch announced by a reader (0 while outside the table)
+typedef struct __attribute__((aligned(64)))
+{
+    uint64_t epoch;
+} hash_reservation_t;
+
+// Object representing a concurrent hash table
+typedef struct
+{
+    hash_array_t* array;
+    uint64_t entries;
+    uint64_t epoch;
+
+    hash_stripe_t stripes[HASH_CONCURRENT_STRIPES];
+    hash_reservation_t reservations[HASH_CONCURRENT_THREADS];
+
+    size_t (*keysize)(const void*);
+    int (*keycmp)(const void*, const void*);
+    uint32_t (*keyhash)(const void*, size_t);
+} hash_concurrent_t;
+
+// Initalize a concurrent hash table object (not thread safe)
+// keysize may be NULL when keyhash ignores length (e.g. hash_u32 or hash_u64)
+extern void hash_concurrent_init(hash_concurrent_t* table, uint32_t size, size_t (*keysize)(const void*), int (*keycmp)(const void*, const void*), uint32_t (*keyhash)(const void*, size_t));
+
+// Cleanup and deallocate a concurrent hash table object (not thread safe)
+extern void hash_concurrent_free(hash_concurrent_t* table, void (*keyfree)(const void*), void (*datafree)(const void*));
+
+// Insert new entry into concurrent hash table using specified key O(1)
+extern void hash_concurrent_insert(hash_concurrent_t* table, const void* key, const void* data);
+
+// Return data of the entry with specified key without taking locks O(1)
+extern void* hash_concurrent_search(hash_concurrent_t* table, const void* key);
+
+// Remove entry with specified key returning data O(1)
+extern void* hash_concurrent_remove(hash_concurrent_t* table, const void* key);
+
+// Print table statistics
+extern void hash_concurrent_print_stats(hash_concurrent_t* table);
@@ -0,0 +1,56 @@
+// hash-sharded.h
+// kpadron.github@gmail.com
+// Kristian Padron
+// hash table split into independently locked and resized shards
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "hash-table.h"
+
+// Shards used when none are requested (rounded up to a power of 2 otherwise)
+#define HASH_SHARDS 64
+
+// Object representing one shard (a complete table with its own lock)
+typedef struct __attribute__((aligned(64)))
+{
+    pthread_mutex_t lock;
+    hash_t table;
+} hash_shard_t;
+
+// Object representing a sharded hash table (keys routed by the high bits of their hash)
+typedef struct
+{
+    uint32_t count;
+    uint32_t bits;
+    hash_shard_t* shards;
+
+    size_t (*keysize)(const void*);
+    uint32_t (*keyhash)(const void*, size_t);
+} hash_sharded_t;
+
+// Initalize a sharded hash table object of specified shards (0 uses HASH_SHARDS) not thread safe
+// Arguments otherwise match hash_init and size is the expected total entries
+extern void hash_sharded_init(hash_sharded_t* table, uint32_t shards, uint32_t size, size_t (*keysize)(const void*), int (*keycmp)(const void*, const void*), uint32_t (*keyhash)(const void*, size_t), uint32_t (*hashmap)(uint32_t, uint32_t));
+
+// Cleanup and deallocate a sharded hash table object (not thread safe)
+extern void hash_sharded_free(hash_sharded_t* table, void (*keyfree)(const void*), void (*datafree)(const void*));
+
+// Insert new entry locking only the shard of key O(1)
+extern void hash_sharded_insert(hash_sharded_t* table, const void* key, const void* data);
+
+// Return data of the entry with specified key locking only its shard O(1)
+extern void* hash_sharded_search(hash_sharded_t* table, const void* key);
+
+// Remove entry with specified key locking only its shard returning data O(1)
+extern void* hash_sharded_remove(hash_sharded_t* table, const void* key);
+
+// Insert n entries using specified threads that each own a subset of shards
+extern void hash_sharded_build(hash_sharded_t* table, const void* const* keys, const void* const* data, size_t n, uint32_t threads);
+
+// Return total entries (exact only while no writer is active)
+extern uint64_t hash_sharded_entries(const hash_sharded_t* table);
+
+// Print table statistics
+extern void hash_sharded_print_stats(hash_sharded_t* table);
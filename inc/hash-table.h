@@ -6,25 +6,59 @@
 #include <stdlib.h>
 #include <stdint.h>
 
-#define HASH_BLOCK_SIZE 32
 #define HASH_GROWTH_FACTOR 2
 #define HASH_MAX_ALPHA 64
 
+// Entries stored inside a cache line sized bucket before spilling to a chain
+#define HASH_BUCKET_INLINE 2
+
+// Chains grow geometrically from HASH_CHAIN_MIN entries in power of 2 size classes
+#define HASH_CHAIN_MIN 2
+#define HASH_CHAIN_CLASSES 32
+
+// Keys hashed and prefetched together before batch operations probe them
+#define HASH_BATCH_SIZE 32
+
+// Chain slabs start at HASH_SLAB_SIZE bytes and double up to HASH_SLAB_MAX
+#define HASH_SLAB_SIZE (1 << 16)
+#define HASH_SLAB_MAX (1 << 22)
+
 // Object representing a hash table entry
 typedef struct
 {
     const void* key;
     const void* data;
+    uint32_t hash;
 } entry_t;
 
-// Object representing a hash table bucket chain
-typedef struct
+// Object representing a hash table bucket (size is chain capacity, 0 while entries are inline)
+// Spilled chains store an 8-bit tag per entry after the entries for SIMD scans
+typedef struct __attribute__((aligned(64)))
 {
     uint32_t count;
     uint32_t size;
-    entry_t* chain;
+    union
+    {
+        entry_t* chain;
+        entry_t entries[HASH_BUCKET_INLINE];
+    };
 } bucket_t;
 
+// Object representing slab memory for bucket chains with per size class free lists
+typedef struct
+{
+    void* free[HASH_CHAIN_CLASSES];
+    void* slabs;
+    char* cursor;
+    size_t remaining;
+    size_t slab_size;
+    uint64_t reserved;
+    uint64_t used;
+} hash_arena_t;
+
+// Object representing a hash table storage engine
+typedef struct hash_backend hash_backend_t;
+
 // Object representing a hash table
 typedef struct
 {
@@ -32,15 +66,70 @@ typedef struct
     uint32_t size;
     bucket_t* buckets;
 
+    // Buckets awaiting migration during an incremental resize
+    bucket_t* old_buckets;
+    uint32_t old_size;
+    uint32_t migrated;
+    uint32_t rehash_step;
+    uint32_t max_alpha;
+
+    // Chain memory released as a whole when the table is freed
+    hash_arena_t arena;
+
+    // Storage owned by open addressing backends
+    void* store;
+    const hash_backend_t* backend;
+
     size_t (*keysize)(const void*);
     int (*keycmp)(const void*, const void*);
     uint32_t (*keyhash)(const void*, size_t);
     uint32_t (*hashmap)(uint32_t, uint32_t);
 } hash_t;
 
+// Operations implemented by a hash table storage engine
+struct hash_backend
+{
+    const char* name;
+
+    void (*init)(hash_t* table, uint32_t size);
+    void (*free)(hash_t* table, void (*keyfree)(const void*), void (*datafree)(const void*));
+    void (*insert)(hash_t* table, const void* key, const void* data, uint32_t hash);
+    const void** (*find_or_insert)(hash_t* table, const void* key, uint32_t hash, int* inserted);
+    void* (*search)(const hash_t* table, const void* key, uint32_t hash);
+    void* (*remove)(hash_t* table, const void* key, uint32_t hash);
+
+    // Stage 0 prefetches memory addressed by hash, stage 1 memory found there
+    void (*prefetch)(const hash_t* table, uint32_t hash, int stage);
+    void (*print_stats)(const hash_t* table);
+    void (*print_debug)(const hash_t* table);
+};
+
+// Sorted bucket chains with binary search (default)
+extern const hash_backend_t hash_backend_chained;
+
+// Open addressing with SIMD probing of 16 byte control groups
+extern const hash_backend_t hash_backend_swiss;
+
+// Linear probing with robin hood displacement and backward shift deletion
+extern const hash_backend_t hash_backend_robin;
+
+// Two choice cuckoo hashing with cache line buckets and a small stash
+extern const hash_backend_t hash_backend_cuckoo;
+
 // Initalize a hash table object
+// keysize may be NULL when keyhash ignores length (e.g. hash_u32 or hash_u64)
 extern void hash_init(hash_t* table, uint32_t size, size_t (*keysize)(const void*), int (*keycmp)(const void*, const void*), uint32_t (*keyhash)(const void*, size_t), uint32_t (*hashmap)(uint32_t, uint32_t));
 
+// Initalize a hash table object using specified storage engine
+// Open addressing backends size themselves in powers of 2 and ignore hashmap
+extern void hash_init_backend(hash_t* table, const hash_backend_t* backend, uint32_t size, size_t (*keysize)(const void*), int (*keycmp)(const void*, const void*), uint32_t (*keyhash)(const void*, size_t), uint32_t (*hashmap)(uint32_t, uint32_t));
+
+// Spread chained table resizes over later operations migrating step buckets each (0 resizes at once)
+extern void hash_set_incremental(hash_t* table, uint32_t step);
+
+// Set average chained bucket depth that triggers growth (HASH_MAX_ALPHA by default)
+extern void hash_set_max_alpha(hash_t* table, uint32_t alpha);
+
 // Cleanup and deallocate a hash table object
 extern void hash_free(hash_t* table, void (*keyfree)(const void*), void (*datafree)(const void*));
 
@@ -50,9 +139,41 @@ extern void hash_insert(hash_t* table, const void* key, const void* data);
 // Return data of the entry with specified key O(1)
 extern void* hash_search(const hash_t* table, const void* key);
 
+// Return pointer to data of the entry with specified key inserting it with NULL data if absent O(1)
+// Sets inserted (may be NULL) to 1 for a new entry, the pointer is valid until the table is next modified
+extern void** hash_find_or_insert(hash_t* table, const void* key, int* inserted);
+
+// Insert data or replace existing data with merge(existing, data) returning stored data O(1)
+// A NULL merge keeps the new data, merge must not modify the table
+extern void* hash_upsert(hash_t* table, const void* key, const void* data, void* (*merge)(void*, const void*));
+
 // Remove entry with specified key returning data O(1)
 extern void* hash_remove(hash_t* table, const void* key);
 
+// Return hash of key as computed by table so it can be reused by the prehashed operations
+// The hash is valid for any table sharing keysize and keyhash (backend and hashmap may differ)
+extern uint32_t hash_key_hash(const hash_t* table, const void* key);
+
+// Insert new entry using hash previously returned by hash_key_hash O(1)
+extern void hash_insert_h(hash_t* table, const void* key, const void* data, uint32_t hash);
+
+// Return data of the entry with specified key using hash previously returned by hash_key_hash O(1)
+extern void* hash_search_h(const hash_t* table, const void* key, uint32_t hash);
+
+// Remove entry with specified key using hash previously returned by hash_key_hash returning data O(1)
+extern void* hash_remove_h(hash_t* table, const void* key, uint32_t hash);
+
+// Insert n entries prefetching their buckets a batch at a time
+extern void hash_insert_batch(hash_t* table, const void* const* keys, const void* const* data, size_t n);
+
+// Store data of each of n keys (NULL if absent) in out prefetching their buckets a batch at a time
+extern void hash_search_batch(const hash_t* table, const void* const* keys, size_t n, void** out);
+
+// Insert n entries hashing them on nthreads threads (0 uses every core) O(N)
+// An empty table is sized once, chained storage places and sorts each chain once
+// Duplicate keys keep the first key and the last data as repeated hash_insert does
+extern void hash_build(hash_t* table, const void* const* keys, const void* const* data, size_t n, uint32_t nthreads);
+
 // Print table statistics
 extern void hash_print_stats(const hash_t* table);
 
@@ -6,23 +6,184 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#define HASH_SEED (uint32_t) 0xDEADBEEF
+#define HASH_FILE_BLOCK_SIZE (1 << 20)
+#define HASH_FILE_DEPTH 4
+#define HASH_VECTOR_STRIPE 64
+#define HASH_VECTOR_BLOCK 1024
+
+// Object representing a 128-bit hash
+typedef struct
+{
+    uint64_t lo;
+    uint64_t hi;
+} hash128_t;
+
+// Object representing incremental FNV1A hash state
+typedef struct
+{
+    uint32_t h;
+} hash_fnv1a_state_t;
+
+// Object representing incremental jenkins one-at-a-time hash state
+typedef struct
+{
+    uint32_t h;
+} hash_oaat_state_t;
+
+// Object representing incremental murmur3 hash state
+typedef struct
+{
+    uint32_t h;
+    uint32_t count;
+    uint8_t buffer[4];
+    uint64_t length;
+} hash_murmur3_state_t;
+
+// Object representing incremental xxHash state
+typedef struct
+{
+    uint32_t v[4];
+    uint32_t seed;
+    uint32_t count;
+    uint8_t buffer[16];
+    uint64_t length;
+} hash_xxhash_state_t;
+
+// Object representing incremental vectorized hash state
+typedef struct
+{
+    uint64_t acc[8];
+    uint64_t seed;
+    uint64_t length;
+    uint32_t count;
+    uint8_t buffer[HASH_VECTOR_STRIPE + HASH_VECTOR_BLOCK];
+} hash_vector_state_t;
+
 // Compute 32-bit hash of file's contents
+// Pipes and special files are read in one pass in constant memory for an incremental hash
+// (fnv1a, oaat, murmur3, xxhash, vector or crc32c), any other buffers the whole input
 extern uint32_t hash_file(const char* path, uint32_t (*hash)(const void*, size_t));
 
+// Compute 32-bit hash of file's contents reading blocks ahead of hashing
+// A reader thread keeps up to depth blocks of block_size bytes queued
+// Memory stays bounded only for incremental hashes (see hash_file)
+extern uint32_t hash_file_pipeline(const char* path, uint32_t (*hash)(const void*, size_t), size_t block_size, uint32_t depth);
+
+// Compute 32-bit tree hash of file's contents using multiple threads
+// Fixed size chunks are hashed independently and their digests combined
+// pairwise in order, so the result does not depend on thread count
+extern uint32_t hash_file_parallel(const char* path, uint32_t (*hash)(const void*, size_t), uint32_t nthreads);
+
 // Compute 32-bit FNV1A hash
 extern uint32_t hash_fnv1a(const void* key, size_t length);
 
+// Initialize incremental 32-bit FNV1A hash state
+extern void hash_fnv1a_init(hash_fnv1a_state_t* state);
+
+// Add bytes to incremental 32-bit FNV1A hash state
+extern void hash_fnv1a_update(hash_fnv1a_state_t* state, const void* key, size_t length);
+
+// Compute 32-bit FNV1A hash of all bytes added to state
+extern uint32_t hash_fnv1a_final(const hash_fnv1a_state_t* state);
+
 // Compute 32-bit jenkins one-at-a-time hash
 extern uint32_t hash_oaat(const void* key, size_t length);
 
+// Initialize incremental 32-bit jenkins one-at-a-time hash state
+extern void hash_oaat_init(hash_oaat_state_t* state);
+
+// Add bytes to incremental 32-bit jenkins one-at-a-time hash state
+extern void hash_oaat_update(hash_oaat_state_t* state, const void* key, size_t length);
+
+// Compute 32-bit jenkins one-at-a-time hash of all bytes added to state
+extern uint32_t hash_oaat_final(const hash_oaat_state_t* state);
+
+// Compute 32-bit CRC32C (Castagnoli) hash
+// Uses the SSE4.2 crc32 instruction when available and lookup tables otherwise
+extern uint32_t hash_crc32c(const void* key, size_t length);
+
+// Compute 32-bit hash of a 32-bit integer key (murmur3 finalizer, length is ignored)
+extern uint32_t hash_u32(const void* key, size_t length);
+
+// Compute 32-bit hash of a 64-bit integer key (murmur3 64-bit finalizer, length is ignored)
+extern uint32_t hash_u64(const void* key, size_t length);
+
+// Compute 32-bit multiplicative (multiply-shift) hash of a 32-bit integer key (length is ignored)
+extern uint32_t hash_u32_ms(const void* key, size_t length);
+
+// Compute 32-bit multiplicative (multiply-shift) hash of a 64-bit integer key (length is ignored)
+extern uint32_t hash_u64_ms(const void* key, size_t length);
+
 // Compute 32-bit murmur3 hash with constant seed
 extern uint32_t hash_murmur3(const void* key, size_t length);
 
 // Compute 32-bit murmur3 hash with seed
 extern uint32_t hash_murmur3s(const void* key, size_t length, uint32_t seed);
 
+// Compute 128-bit murmur3 (x64) hash with constant seed
+extern hash128_t hash_murmur3_128(const void* key, size_t length);
+
+// Compute 128-bit murmur3 (x64) hash with seed
+extern hash128_t hash_murmur3_128s(const void* key, size_t length, uint32_t seed);
+
+// Compute 32-bit murmur3 hash with constant seed of many keys at once
+// Groups of 8 short keys are hashed in parallel SIMD lanes when AVX2 is available
+extern void hash_murmur3_batch(const void* const* keys, const size_t* lengths, uint32_t* out, size_t n);
+
+// Initialize incremental 32-bit murmur3 hash state with seed
+extern void hash_murmur3_init(hash_murmur3_state_t* state, uint32_t seed);
+
+// Add bytes to incremental 32-bit murmur3 hash state
+extern void hash_murmur3_update(hash_murmur3_state_t* state, const void* key, size_t length);
+
+// Compute 32-bit murmur3 hash of all bytes added to state
+extern uint32_t hash_murmur3_final(const hash_murmur3_state_t* state);
+
 // Compute 32-bit xxHash with constant seed
 extern uint32_t hash_xxhash(const void* key, size_t length);
 
 // Compute 32-bit xxHash with seed
 extern uint32_t hash_xxhashs(const void* key, size_t length, uint32_t seed);
+
+// Compute 64-bit xxHash with constant seed
+extern uint64_t hash_xxhash64(const void* key, size_t length);
+
+// Compute 64-bit xxHash with seed
+extern uint64_t hash_xxhash64s(const void* key, size_t length, uint64_t seed);
+
+// Compute 32-bit xxHash with constant seed of many keys at once
+// Groups of 8 short keys are hashed in parallel SIMD lanes when AVX2 is available
+extern void hash_xxhash_batch(const void* const* keys, const size_t* lengths, uint32_t* out, size_t n);
+
+// Initialize incremental 32-bit xxHash state with seed
+extern void hash_xxhash_init(hash_xxhash_state_t* state, uint32_t seed);
+
+// Add bytes to incremental 32-bit xxHash state
+extern void hash_xxhash_update(hash_xxhash_state_t* state, const void* key, size_t length);
+
+// Compute 32-bit xxHash of all bytes added to state
+extern uint32_t hash_xxhash_final(const hash_xxhash_state_t* state);
+
+// Compute 32-bit vectorized long input hash with constant seed
+// Uses the best instruction set available at runtime (AVX-512, AVX2, SSE2 or scalar)
+extern uint32_t hash_vector(const void* key, size_t length);
+
+// Compute 32-bit vectorized long input hash with seed
+extern uint32_t hash_vectors(const void* key, size_t length, uint32_t seed);
+
+// Initialize incremental 32-bit vectorized hash state with seed
+extern void hash_vector_init(hash_vector_state_t* state, uint32_t seed);
+
+// Add bytes to incremental 32-bit vectorized hash state
+extern void hash_vector_update(hash_vector_state_t* state, const void* key, size_t length);
+
+// Compute 32-bit vectorized hash of all bytes added to state
+extern uint32_t hash_vector_final(const hash_vector_state_t* state);
+
+// Return name of instruction set used by vectorized hash
+extern const char* hash_vector_isa(void);
+
+// Select instruction set used by vectorized hash (NULL selects the best supported)
+// Returns nonzero if the instruction set is unknown or unsupported
+extern int hash_vector_select(const char* isa);
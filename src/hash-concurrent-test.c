@@ -0,0 +1,288 @@
+// hash-concurrent-test.c
+// kpadron.github@gmail.com
+// Kristian Padron
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "hash.h"
+#include "hash-table.h"
+#include "hash-concurrent.h"
+#include "hash-sharded.h"
+
+// Keys preloaded and never removed, followed by as many keys writers insert and remove
+#define STABLE_KEYS (1 << 20)
+#define TOTAL_KEYS (2 * STABLE_KEYS)
+
+typedef struct
+{
+    const char* name;
+    int locked;
+} config_t;
+
+typedef struct
+{
+    pthread_t thread;
+    uint64_t state;
+    uint64_t ops;
+} worker_t;
+
+void run(const config_t* config, uint32_t threads, double test_duration);
+void build(uint32_t max_threads);
+void* work(void* arg);
+double wtime(void);
+
+static int keycmp(const void* a, const void* b)
+{
+    const uint64_t x = *(const uint64_t*) a;
+    const uint64_t y = *(const uint64_t*) b;
+
+    return (x > y) - (x < y);
+}
+
+static const config_t configs[] =
+{
+    { "mutex", 1 },
+    { "concurrent", 0 },
+};
+
+// Shared by workers of the configuration being run
+static uint64_t keys[TOTAL_KEYS];
+static uint32_t write_percent = 10;
+static int stop;
+static const config_t* current;
+static hash_t locked_table;
+static pthread_mutex_t locked_mutex = PTHREAD_MUTEX_INITIALIZER;
+static hash_concurrent_t concurrent_table;
+
+
+int main(int argc, char** argv)
+{
+    double test_duration = 1;
+    uint32_t max_threads = 2 * sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (argc > 1)
+    {
+        test_duration = atof(argv[1]);
+    }
+
+    if (argc > 2)
+    {
+        max_threads = atoi(argv[2]);
+    }
+
+    if (argc > 3)
+    {
+        write_percent = atoi(argv[3]);
+    }
+
+    for (uint64_t i = 0; i < TOTAL_KEYS; i++) keys[i] = i * 0x9E3779B97F4A7C15;
+
+    printf("read/write throughput with %u%% writes\n", write_percent);
+
+    for (uint32_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) run(&configs[i], threads, test_duration);
+    }
+
+    build(max_threads);
+
+    return 0;
+}
+
+
+void run(const config_t* config, uint32_t threads, double test_duration)
+{
+    current = config;
+    stop = 0;
+
+    if (config->locked) hash_init(&locked_table, STABLE_KEYS, NULL, keycmp, hash_u64, NULL);
+    else hash_concurrent_init(&concurrent_table, STABLE_KEYS, NULL, keycmp, hash_u64);
+
+    for (uint64_t i = 0; i < STABLE_KEYS; i++)
+    {
+        if (config->locked) hash_insert(&locked_table, &keys[i], &keys[i]);
+        else hash_concurrent_insert(&concurrent_table, &keys[i], &keys[i]);
+    }
+
+    worker_t* workers = (worker_t*) calloc(threads, sizeof(worker_t));
+
+    const double test_start = wtime();
+
+    for (uint32_t i = 0; i < threads; i++)
+    {
+        workers[i].state = 0x2545F4914F6CDD1D * (i + 1);
+        pthread_create(&workers[i].thread, NULL, work, &workers[i]);
+    }
+
+    usleep(test_duration * 1E6);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+    uint64_t ops = 0;
+    for (uint32_t i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        ops += workers[i].ops;
+    }
+
+    const double test_time = wtime() - test_start;
+
+    printf("[%s] threads: %u, %zu operations over %.2f s -> %.2f Mops per second\n", config->name, threads, (size_t) ops, test_time, ops / test_time / 1E6);
+
+    // Stable keys must survive concurrent writers
+    for (uint64_t i = 0; i < STABLE_KEYS; i++)
+    {
+        void* hd = config->locked ? hash_search(&locked_table, &keys[i]) : hash_concurrent_search(&concurrent_table, &keys[i]);
+        assert(hd == &keys[i]);
+    }
+
+    if (config->locked) hash_free(&locked_table, NULL, NULL);
+    else
+    {
+        hash_concurrent_print_stats(&concurrent_table);
+        hash_concurrent_free(&concurrent_table, NULL, NULL);
+    }
+
+    free(workers);
+}
+
+
+// Insert every key into one table, into shards one at a time, then into shards in parallel
+void build(uint32_t max_threads)
+{
+    const void** pointers = (const void**) malloc(TOTAL_KEYS * sizeof(void*));
+    for (uint64_t i = 0; i < TOTAL_KEYS; i++) pointers[i] = &keys[i];
+
+    printf("\nbuild of %u entries\n", TOTAL_KEYS);
+
+    // Whole table rehashes show up as the worst insert
+    hash_t table;
+    hash_sharded_t sharded;
+    double test_start = 0;
+    double test_time = 0;
+    double test_worst = 0;
+
+    hash_init(&table, 10, NULL, keycmp, hash_u64, NULL);
+    for (uint64_t i = 0; i < TOTAL_KEYS; i++)
+    {
+        test_start = wtime();
+        hash_insert(&table, pointers[i], pointers[i]);
+        const double t = wtime() - test_start;
+
+        test_time += t;
+        test_worst = t > test_worst ? t : test_worst;
+    }
+
+    printf("[single] %.2f s -> %.4f ns per insert, %.0f ns worst\n", test_time, test_time * 1E9 / TOTAL_KEYS, test_worst * 1E9);
+    hash_free(&table, NULL, NULL);
+
+    test_time = 0;
+    test_worst = 0;
+
+    hash_sharded_init(&sharded, 0, 10, NULL, keycmp, hash_u64, NULL);
+    for (uint64_t i = 0; i < TOTAL_KEYS; i++)
+    {
+        test_start = wtime();
+        hash_sharded_insert(&sharded, pointers[i], pointers[i]);
+        const double t = wtime() - test_start;
+
+        test_time += t;
+        test_worst = t > test_worst ? t : test_worst;
+    }
+
+    printf("[sharded] %.2f s -> %.4f ns per insert, %.0f ns worst\n", test_time, test_time * 1E9 / TOTAL_KEYS, test_worst * 1E9);
+    hash_sharded_free(&sharded, NULL, NULL);
+
+    for (uint32_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        hash_sharded_init(&sharded, 0, 10, NULL, keycmp, hash_u64, NULL);
+
+        test_start = wtime();
+        hash_sharded_build(&sharded, pointers, pointers, TOTAL_KEYS, threads);
+        test_time = wtime() - test_start;
+
+        printf("[sharded build] threads: %u, %.2f s -> %.2f M inserts per second\n", threads, test_time, TOTAL_KEYS / test_time / 1E6);
+
+        assert(hash_sharded_entries(&sharded) == TOTAL_KEYS);
+        for (uint64_t i = 0; i < TOTAL_KEYS; i++) assert(hash_sharded_search(&sharded, pointers[i]) == pointers[i]);
+
+        hash_sharded_free(&sharded, NULL, NULL);
+    }
+
+    free(pointers);
+}
+
+
+// Perform random searches, inserts and removes until stopped
+void* work(void* arg)
+{
+    worker_t* worker = (worker_t*) arg;
+
+    while (!__atomic_load_n(&stop, __ATOMIC_RELAXED))
+    {
+        // Private xorshift generator since rand is not thread safe
+        uint64_t x = worker->state;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        worker->state = x;
+
+        const uint64_t index = (x >> 8) % TOTAL_KEYS;
+        const void* key = &keys[index];
+
+        if (x % 100 < write_percent)
+        {
+            // Writers only touch keys that are not preloaded
+            const void* churn = &keys[STABLE_KEYS + index % STABLE_KEYS];
+
+            if (current->locked)
+            {
+                pthread_mutex_lock(&locked_mutex);
+                if (x & 0x80) hash_insert(&locked_table, churn, churn);
+                else hash_remove(&locked_table, churn);
+                pthread_mutex_unlock(&locked_mutex);
+            }
+            else
+            {
+                if (x & 0x80) hash_concurrent_insert(&concurrent_table, churn, churn);
+                else hash_concurrent_remove(&concurrent_table, churn);
+            }
+        }
+        else
+        {
+            void* hd;
+
+            if (current->locked)
+            {
+                pthread_mutex_lock(&locked_mutex);
+                hd = hash_search(&locked_table, key);
+                pthread_mutex_unlock(&locked_mutex);
+            }
+            else
+            {
+                hd = hash_concurrent_search(&concurrent_table, key);
+            }
+
+            // Preloaded keys are always found, others only ever map to themselves
+            if (index < STABLE_KEYS) assert(hd == key);
+            else assert(!hd || hd == key);
+        }
+
+        worker->ops++;
+    }
+
+    return NULL;
+}
+
+
+double wtime(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1E9;
+}
@@ -0,0 +1,467 @@
+// hash-concurrent.c
+// kpadron.github@gmail.com
+// Kristian Padron
+// thread safe hash table with lock striped writers and lock free readers
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "hash.h"
+#include "hash-concurrent.h"
+
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+
+// Reservation slots are shared by every table and released when their thread exits
+static pthread_once_t _slot_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _slot_key;
+static pthread_mutex_t _slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t _slot_used[HASH_CONCURRENT_THREADS];
+static uint32_t _slot_count;
+static __thread int32_t _slot = -1;
+
+
+// Compute the next highest power of 2
+static inline uint32_t _up2(uint32_t x)
+{
+    x--;
+    x |= x >> 1;
+    x |= x >> 2;
+    x |= x >> 4;
+    x |= x >> 8;
+    x |= x >> 16;
+    x++;
+    return x + (x == 0);
+}
+
+// Compute hash of key (keysize may be omitted for fixed width hashes)
+static inline uint32_t _hash_key(const hash_concurrent_t* table, const void* key)
+{
+    return table->keyhash(key, table->keysize ? table->keysize(key) : 0);
+}
+
+
+// Return reservation slot of exiting thread
+static void _slot_release(void* value)
+{
+    pthread_mutex_lock(&_slot_lock);
+    _slot_used[(uintptr_t) value - 1] = 0;
+    __atomic_sub_fetch(&_slot_count, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&_slot_lock);
+}
+
+// Create key whose destructor releases reservation slots
+static void _slot_create(void)
+{
+    pthread_key_create(&_slot_key, _slot_release);
+}
+
+// Return reservation slot of calling thread claiming one on first use or -1 if every slot is taken
+static int32_t _thread_slot(void)
+{
+    if (_slot >= 0) return _slot;
+
+    // More than HASH_CONCURRENT_THREADS threads are using concurrent tables (checked again once one exits)
+    if (__atomic_load_n(&_slot_count, __ATOMIC_RELAXED) >= HASH_CONCURRENT_THREADS) return -1;
+
+    pthread_once(&_slot_once, _slot_create);
+
+    pthread_mutex_lock(&_slot_lock);
+    for (uint32_t i = 0; i < HASH_CONCURRENT_THREADS && _slot < 0; i++)
+    {
+        if (!_slot_used[i])
+        {
+            _slot_used[i] = 1;
+            _slot = i;
+            __atomic_add_fetch(&_slot_count, 1, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&_slot_lock);
+
+    if (_slot < 0) return -1;
+
+    pthread_setspecific(_slot_key, (void*) (uintptr_t) (_slot + 1));
+    return _slot;
+}
+
+
+// Allocate chain holding count entries
+static hash_chain_t* _chain_alloc(uint32_t count)
+{
+    hash_chain_t* chain = (hash_chain_t*) malloc(sizeof(hash_chain_t) + count * sizeof(entry_t));
+    chain->count = count;
+
+    return chain;
+}
+
+// Return index of entry with specified key or -1
+static int64_t _chain_find(const hash_concurrent_t* table, const hash_chain_t* chain, const void* key, uint32_t hash)
+{
+    if (!chain) return -1;
+
+    for (uint32_t j = 0; j < chain->count; j++)
+    {
+        if (chain->entries[j].hash == hash && !table->keycmp(key, chain->entries[j].key)) return j;
+    }
+
+    return -1;
+}
+
+
+// Allocate bucket array of empty chains
+static hash_array_t* _array_alloc(uint32_t size)
+{
+    hash_array_t* array = (hash_array_t*) calloc(1, sizeof(hash_array_t) + size * sizeof(hash_chain_t*));
+    array->size = size;
+
+    return array;
+}
+
+// Deallocate bucket array together with its chains
+static void _array_free(void* ptr)
+{
+    hash_array_t* array = (hash_array_t*) ptr;
+
+    for (uint32_t i = 0; i < array->size; i++) free(array->buckets[i]);
+    free(array);
+}
+
+
+// Announce current epoch so nothing reachable from here on is reclaimed (NULL if the thread has no slot)
+static hash_reservation_t* _reader_enter(hash_concurrent_t* table)
+{
+    const int32_t slot = _thread_slot();
+    if (slot < 0) return NULL;
+
+    hash_reservation_t* reservation = &table->reservations[slot];
+
+    __atomic_store_n(&reservation->epoch, __atomic_load_n(&table->epoch, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+
+    // Announcement must be visible before any pointer is loaded
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    return reservation;
+}
+
+// Withdraw announcement once no pointers are held
+static void _reader_leave(hash_reservation_t* reservation)
+{
+    __atomic_store_n(&reservation->epoch, 0, __ATOMIC_RELEASE);
+}
+
+
+// Free memory retired before the oldest epoch any reader announced
+static void _reclaim(hash_concurrent_t* table, hash_stripe_t* stripe)
+{
+    // Readers entering from now on cannot reach anything already retired
+    __atomic_fetch_add(&table->epoch, 1, __ATOMIC_SEQ_CST);
+
+    uint64_t oldest = UINT64_MAX;
+    for (uint32_t i = 0; i < HASH_CONCURRENT_THREADS; i++)
+    {
+        const uint64_t epoch = __atomic_load_n(&table->reservations[i].epoch, __ATOMIC_ACQUIRE);
+        if (epoch && epoch < oldest) oldest = epoch;
+    }
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < stripe->count; i++)
+    {
+        const hash_retired_t* retired = &stripe->retired[i];
+
+        if (retired->epoch < oldest) retired->free(retired->ptr);
+        else stripe->retired[kept++] = *retired;
+    }
+
+    // Stores of count are atomic since statistics sample it without the lock
+    __atomic_store_n(&stripe->count, kept, __ATOMIC_RELAXED);
+}
+
+// Defer freeing memory just unlinked until no reader can hold it (stripe lock held)
+static void _retire(hash_concurrent_t* table, hash_stripe_t* stripe, void* ptr, void (*free)(void*))
+{
+    // Unlink must be visible before the epoch is sampled
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    const uint64_t epoch = __atomic_load_n(&table->epoch, __ATOMIC_RELAXED);
+
+    // Reclaim when full and grow if long readers keep most of it alive
+    if (stripe->count == stripe->size)
+    {
+        _reclaim(table, stripe);
+
+        if (stripe->count >= stripe->size / 2)
+        {
+            stripe->size = MAX(stripe->size * 2, HASH_CONCURRENT_RETIRE);
+            stripe->retired = (hash_retired_t*) realloc(stripe->retired, stripe->size * sizeof(hash_retired_t));
+        }
+    }
+
+    stripe->retired[stripe->count].ptr = ptr;
+    stripe->retired[stripe->count].free = free;
+    stripe->retired[stripe->count].epoch = epoch;
+    __atomic_store_n(&stripe->count, stripe->count + 1, __ATOMIC_RELAXED);
+}
+
+
+// Replace bucket array with one of specified size unless another writer already did
+static void _concurrent_resize(hash_concurrent_t* table, uint32_t from, uint32_t size)
+{
+    // Holding every stripe stops writers while readers continue on the old array
+    for (uint32_t i = 0; i < HASH_CONCURRENT_STRIPES; i++) pthread_mutex_lock(&table->stripes[i].lock);
+
+    hash_array_t* old = table->array;
+
+    if (old->size == from)
+    {
+        hash_array_t* array = _array_alloc(size);
+        uint32_t* counts = (uint32_t*) calloc(size, sizeof(uint32_t));
+
+        // Count entries destined for each bucket using stored hashes
+        for (uint32_t i = 0; i < old->size; i++)
+        {
+            const hash_chain_t* chain = old->buckets[i];
+            for (uint32_t j = 0; chain && j < chain->count; j++) counts[chain->entries[j].hash & (size - 1)]++;
+        }
+
+        for (uint32_t i = 0; i < size; i++)
+        {
+            if (counts[i]) array->buckets[i] = _chain_alloc(counts[i]);
+        }
+
+        // Fill chains back to front reusing counts as cursors
+        for (uint32_t i = 0; i < old->size; i++)
+        {
+            const hash_chain_t* chain = old->buckets[i];
+
+            for (uint32_t j = 0; chain && j < chain->count; j++)
+            {
+                const uint32_t index = chain->entries[j].hash & (size - 1);
+                array->buckets[index]->entries[--counts[index]] = chain->entries[j];
+            }
+        }
+
+        free(counts);
+
+        // Old array and its chains stay intact for readers that loaded them
+        __atomic_store_n(&table->array, array, __ATOMIC_RELEASE);
+        _retire(table, &table->stripes[0], old, _array_free);
+    }
+
+    for (uint32_t i = HASH_CONCURRENT_STRIPES; i--;) pthread_mutex_unlock(&table->stripes[i].lock);
+}
+
+
+// Initalize a concurrent hash table object
+void hash_concurrent_init(hash_concurrent_t* table, uint32_t size, size_t (*keysize)(const void*), int (*keycmp)(const void*, const void*), uint32_t (*keyhash)(const void*, size_t))
+{
+    if (!table) return;
+
+    // Initialize table functions
+    table->keysize = keysize;
+    table->keycmp = keycmp;
+    table->keyhash = keyhash ? keyhash : hash_fnv1a;
+
+    // Every bucket belongs to exactly one stripe when both are powers of 2
+    table->array = _array_alloc(_up2(MAX(size / HASH_CONCURRENT_ALPHA, HASH_CONCURRENT_STRIPES)));
+    table->entries = 0;
+    table->epoch = 1;
+
+    for (uint32_t i = 0; i < HASH_CONCURRENT_STRIPES; i++)
+    {
+        hash_stripe_t* stripe = &table->stripes[i];
+
+        pthread_mutex_init(&stripe->lock, NULL);
+        stripe->retired = NULL;
+        stripe->count = 0;
+        stripe->size = 0;
+    }
+
+    for (uint32_t i = 0; i < HASH_CONCURRENT_THREADS; i++) table->reservations[i].epoch = 0;
+}
+
+
+// Cleanup and deallocate a concurrent hash table object
+void hash_concurrent_free(hash_concurrent_t* table, void (*keyfree)(const void*), void (*datafree)(const void*))
+{
+    if (!table) return;
+
+    // Free key and data if free functions are provided
+    if (keyfree || datafree)
+    {
+        for (uint32_t i = 0; i < table->array->size; i++)
+        {
+            const hash_chain_t* chain = table->array->buckets[i];
+
+            for (uint32_t j = 0; chain && j < chain->count; j++)
+            {
+                if (keyfree) keyfree(chain->entries[j].key);
+                if (datafree) datafree(chain->entries[j].data);
+            }
+        }
+    }
+
+    // No reader may be active so every retired object is released
+    for (uint32_t i = 0; i < HASH_CONCURRENT_STRIPES; i++)
+    {
+        hash_stripe_t* stripe = &table->stripes[i];
+
+        for (uint32_t j = 0; j < stripe->count; j++) stripe->retired[j].free(stripe->retired[j].ptr);
+
+        free(stripe->retired);
+        pthread_mutex_destroy(&stripe->lock);
+    }
+
+    _array_free(table->array);
+    table->array = NULL;
+}
+
+
+// Insert new entry into concurrent hash table using specified key O(1)
+void hash_concurrent_insert(hash_concurrent_t* table, const void* key, const void* data)
+{
+    if (!table) return;
+
+    const uint32_t hash = _hash_key(table, key);
+    hash_stripe_t* stripe = &table->stripes[hash & (HASH_CONCURRENT_STRIPES - 1)];
+
+    pthread_mutex_lock(&stripe->lock);
+
+    hash_array_t* array = __atomic_load_n(&table->array, __ATOMIC_ACQUIRE);
+    hash_chain_t** bucket = &array->buckets[hash & (array->size - 1)];
+    hash_chain_t* old = *bucket;
+
+    // Update existing entry in place (duplicates not allowed!)
+    const int64_t index = _chain_find(table, old, key, hash);
+    if (index >= 0)
+    {
+        __atomic_store_n(&old->entries[index].data, data, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&stripe->lock);
+        return;
+    }
+
+    // Publish a copy with the new entry appended
+    const uint32_t count = old ? old->count : 0;
+    hash_chain_t* chain = _chain_alloc(count + 1);
+
+    if (old) memcpy(chain->entries, old->entries, count * sizeof(entry_t));
+    chain->entries[count].key = key;
+    chain->entries[count].data = data;
+    chain->entries[count].hash = hash;
+
+    __atomic_store_n(bucket, chain, __ATOMIC_RELEASE);
+    if (old) _retire(table, stripe, old, free);
+
+    const uint64_t entries = __atomic_add_fetch(&table->entries, 1, __ATOMIC_RELAXED);
+    const uint32_t size = array->size;
+
+    pthread_mutex_unlock(&stripe->lock);
+
+    // Resize table if necessary
+    if (entries > (uint64_t) size * HASH_CONCURRENT_ALPHA) _concurrent_resize(table, size, size * 2);
+}
+
+
+// Return data of the entry with specified key without taking locks O(1)
+void* hash_concurrent_search(hash_concurrent_t* table, const void* key)
+{
+    if (!table) return NULL;
+
+    const uint32_t hash = _hash_key(table, key);
+    hash_stripe_t* stripe = &table->stripes[hash & (HASH_CONCURRENT_STRIPES - 1)];
+    void* data = NULL;
+
+    // Threads without a reservation read under the stripe lock which keeps their bucket and array in place
+    hash_reservation_t* reservation = _reader_enter(table);
+    if (!reservation) pthread_mutex_lock(&stripe->lock);
+
+    const hash_array_t* array = __atomic_load_n(&table->array, __ATOMIC_ACQUIRE);
+    const hash_chain_t* chain = __atomic_load_n(&array->buckets[hash & (array->size - 1)], __ATOMIC_ACQUIRE);
+
+    const int64_t index = _chain_find(table, chain, key, hash);
+    if (index >= 0) data = (void*) __atomic_load_n(&chain->entries[index].data, __ATOMIC_ACQUIRE);
+
+    if (reservation) _reader_leave(reservation);
+    else pthread_mutex_unlock(&stripe->lock);
+
+    return data;
+}
+
+
+// Remove entry with specified key returning data O(1)
+void* hash_concurrent_remove(hash_concurrent_t* table, const void* key)
+{
+    if (!table) return NULL;
+
+    const uint32_t hash = _hash_key(table, key);
+    hash_stripe_t* stripe = &table->stripes[hash & (HASH_CONCURRENT_STRIPES - 1)];
+
+    pthread_mutex_lock(&stripe->lock);
+
+    hash_array_t* array = __atomic_load_n(&table->array, __ATOMIC_ACQUIRE);
+    hash_chain_t** bucket = &array->buckets[hash & (array->size - 1)];
+    hash_chain_t* old = *bucket;
+
+    const int64_t index = _chain_find(table, old, key, hash);
+    if (index < 0)
+    {
+        pthread_mutex_unlock(&stripe->lock);
+        return NULL;
+    }
+
+    void* data = (void*) old->entries[index].data;
+
+    // Publish a copy without the entry (or an empty bucket)
+    hash_chain_t* chain = NULL;
+    if (old->count > 1)
+    {
+        chain = _chain_alloc(old->count - 1);
+        memcpy(chain->entries, old->entries, index * sizeof(entry_t));
+        memcpy(&chain->entries[index], &old->entries[index + 1], (old->count - index - 1) * sizeof(entry_t));
+    }
+
+    __atomic_store_n(bucket, chain, __ATOMIC_RELEASE);
+    _retire(table, stripe, old, free);
+
+    const uint64_t entries = __atomic_sub_fetch(&table->entries, 1, __ATOMIC_RELAXED);
+    const uint32_t size = array->size;
+
+    pthread_mutex_unlock(&stripe->lock);
+
+    // Resize table if necessary
+    if (size > HASH_CONCURRENT_STRIPES && entries * 4 < (uint64_t) size * HASH_CONCURRENT_ALPHA) _concurrent_resize(table, size, size / 2);
+
+    return data;
+}
+
+
+// Print table statistics
+void hash_concurrent_print_stats(hash_concurrent_t* table)
+{
+    if (!table) return;
+
+    // Threads without a reservation stop writers like a resize does
+    hash_reservation_t* reservation = _reader_enter(table);
+    if (!reservation) for (uint32_t i = 0; i < HASH_CONCURRENT_STRIPES; i++) pthread_mutex_lock(&table->stripes[i].lock);
+
+    const hash_array_t* array = __atomic_load_n(&table->array, __ATOMIC_ACQUIRE);
+
+    uint32_t max = 0;
+    for (uint32_t i = 0; i < array->size; i++)
+    {
+        const hash_chain_t* chain = __atomic_load_n(&array->buckets[i], __ATOMIC_ACQUIRE);
+        if (chain) max = MAX(chain->count, max);
+    }
+
+    const uint64_t entries = __atomic_load_n(&table->entries, __ATOMIC_RELAXED);
+    printf("entries: %zu, size: %zu, alpha %.2f, max-depth: %zu\n", (size_t) entries, (size_t) array->size, (float) entries / array->size, (size_t) max);
+
+    if (reservation) _reader_leave(reservation);
+    else for (uint32_t i = HASH_CONCURRENT_STRIPES; i--;) pthread_mutex_unlock(&table->stripes[i].lock);
+
+    // Counts of other stripes may be changing so they are only sampled
+    size_t retired = 0;
+    for (uint32_t i = 0; i < HASH_CONCURRENT_STRIPES; i++) retired += __atomic_load_n(&table->stripes[i].count, __ATOMIC_RELAXED);
+
+    printf("epoch: %zu, retired awaiting reclaim: %zu\n", (size_t) __atomic_load_n(&table->epoch, __ATOMIC_RELAXED), retired);
+}
@@ -0,0 +1,527 @@
+// hash-cuckoo.c
+// kpadron.github@gmail.com
+// Kristian Padron
+// bucketized cuckoo hash table backend with bounded lookups
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hash.h"
+#include "hash-table.h"
+
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+// Slots per bucket (a bucket fills one 64 byte cache line)
+#define CUCKOO_WAYS 3
+#define CUCKOO_LINE 64
+
+// Smallest bucket array allocated
+#define CUCKOO_MIN_BUCKETS 4
+
+// Entries parked when displacement fails before the table is rebuilt
+#define CUCKOO_STASH 8
+
+// Rebuilds with fresh seeds attempted before the stash is grown instead
+#define CUCKOO_MAX_REHASH 8
+
+// Displacements attempted before parking an entry in the stash
+#define CUCKOO_MAX_KICKS 256
+
+// Maximum load factor is CUCKOO_LOAD_NUM / CUCKOO_LOAD_DEN
+#define CUCKOO_LOAD_NUM 9
+#define CUCKOO_LOAD_DEN 10
+
+
+// Object representing a cache line sized bucket (hashes filter keycmp calls)
+typedef struct
+{
+    uint32_t hash[CUCKOO_WAYS];
+    uint32_t used;
+    const void* key[CUCKOO_WAYS];
+    const void* data[CUCKOO_WAYS];
+} cuckoo_bucket_t;
+
+// Object representing cuckoo storage
+typedef struct
+{
+    uint32_t nbuckets;
+    uint32_t limit;
+    uint32_t seed[2];
+    uint32_t state;
+    uint32_t stashed;
+    uint32_t stash_size;
+    cuckoo_bucket_t* buckets;
+    entry_t* stash;
+} cuckoo_t;
+
+
+// Compute the next highest power of 2
+static inline uint32_t _up2(uint32_t x)
+{
+    x--;
+    x |= x >> 1;
+    x |= x >> 2;
+    x |= x >> 4;
+    x |= x >> 8;
+    x |= x >> 16;
+    x++;
+    return x + (x == 0);
+}
+
+// Return next value of storage local xorshift generator
+static inline uint32_t _cuckoo_rand(cuckoo_t* store)
+{
+    uint32_t x = store->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return store->state = x;
+}
+
+// Mix bits of x (murmur3 finalizer)
+static inline uint32_t _cuckoo_mix(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x85EBCA6B;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35;
+    x ^= x >> 16;
+    return x;
+}
+
+// Store both candidate buckets of hash in b (the table hash remixed under each seed)
+static inline void _cuckoo_buckets(const cuckoo_t* store, uint32_t hash, uint32_t* b)
+{
+    b[0] = _cuckoo_mix(hash ^ store->seed[0]) & (store->nbuckets - 1);
+    b[1] = _cuckoo_mix(hash ^ store->seed[1]) & (store->nbuckets - 1);
+}
+
+// Store entry in a free way of bucket returning the way or -1 if full
+static inline int _cuckoo_put(cuckoo_bucket_t* bucket, const entry_t* entry)
+{
+    const uint32_t free = ~bucket->used & ((1 << CUCKOO_WAYS) - 1);
+    if (!free) return -1;
+
+    const uint32_t w = __builtin_ctz(free);
+    bucket->hash[w] = entry->hash;
+    bucket->key[w] = entry->key;
+    bucket->data[w] = entry->data;
+    bucket->used |= 1 << w;
+
+    return w;
+}
+
+// Swap entry with way of bucket
+static inline void _cuckoo_swap(cuckoo_bucket_t* bucket, uint32_t w, entry_t* entry)
+{
+    const entry_t victim = { bucket->key[w], bucket->data[w], bucket->hash[w] };
+
+    bucket->hash[w] = entry->hash;
+    bucket->key[w] = entry->key;
+    bucket->data[w] = entry->data;
+
+    *entry = victim;
+}
+
+
+// Allocate empty storage with specified number of buckets and stash entries
+static void _cuckoo_alloc(cuckoo_t* store, uint32_t nbuckets, uint32_t stash_size)
+{
+    store->nbuckets = nbuckets;
+    store->limit = (uint64_t) nbuckets * CUCKOO_WAYS * CUCKOO_LOAD_NUM / CUCKOO_LOAD_DEN;
+    store->stashed = 0;
+    store->stash_size = stash_size;
+    store->stash = (entry_t*) malloc(stash_size * sizeof(entry_t));
+    store->buckets = (cuckoo_bucket_t*) aligned_alloc(CUCKOO_LINE, nbuckets * sizeof(cuckoo_bucket_t));
+
+    memset(store->buckets, 0, nbuckets * sizeof(cuckoo_bucket_t));
+}
+
+// Return slot of entry with specified key, hash and buckets or -1 (slots past the buckets are in the stash)
+static int64_t _cuckoo_find(const hash_t* table, const cuckoo_t* store, const void* key, uint32_t hash, const uint32_t* b)
+{
+    // At most two buckets (cache lines) hold the key
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        const cuckoo_bucket_t* bucket = &store->buckets[b[i]];
+
+        for (uint32_t w = 0; w < CUCKOO_WAYS; w++)
+        {
+            if ((bucket->used >> w & 1) && bucket->hash[w] == hash && !table->keycmp(key, bucket->key[w]))
+            {
+                return (int64_t) b[i] * CUCKOO_WAYS + w;
+            }
+        }
+    }
+
+    for (uint32_t s = 0; s < store->stashed; s++)
+    {
+        if (store->stash[s].hash == hash && !table->keycmp(key, store->stash[s].key))
+        {
+            return (int64_t) store->nbuckets * CUCKOO_WAYS + s;
+        }
+    }
+
+    return -1;
+}
+
+// Return data pointer stored at slot
+static inline const void** _cuckoo_data(cuckoo_t* store, uint64_t slot)
+{
+    const uint64_t n = (uint64_t) store->nbuckets * CUCKOO_WAYS;
+
+    return slot < n ? &store->buckets[slot / CUCKOO_WAYS].data[slot % CUCKOO_WAYS] : &store->stash[slot - n].data;
+}
+
+// Place entry known to be absent returning 0 if an entry was left over after displacement
+// The slot the entry lands in is stored in placed (unless NULL) and never evicted by the walk
+static int _cuckoo_place(cuckoo_t* store, entry_t* entry, uint64_t* placed)
+{
+    uint32_t c[2];
+    _cuckoo_buckets(store, entry->hash, c);
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        const int w = _cuckoo_put(&store->buckets[c[i]], entry);
+        if (w < 0) continue;
+
+        if (placed) *placed = (uint64_t) c[i] * CUCKOO_WAYS + w;
+        return 1;
+    }
+
+    // Random walk evicting entries into their alternate bucket
+    uint32_t b = c[_cuckoo_rand(store) & 1];
+    uint64_t first = UINT64_MAX;
+
+    for (uint32_t kick = 0; kick < CUCKOO_MAX_KICKS; kick++)
+    {
+        // Evicting the slot taken first would displace the entry being placed
+        uint32_t w = _cuckoo_rand(store) % CUCKOO_WAYS;
+        if ((uint64_t) b * CUCKOO_WAYS + w == first) w = (w + 1) % CUCKOO_WAYS;
+        if (kick == 0) first = (uint64_t) b * CUCKOO_WAYS + w;
+
+        _cuckoo_swap(&store->buckets[b], w, entry);
+
+        _cuckoo_buckets(store, entry->hash, c);
+        b = c[0] == b ? c[1] : c[0];
+
+        if (_cuckoo_put(&store->buckets[b], entry) < 0) continue;
+
+        if (placed) *placed = first;
+        return 1;
+    }
+
+    // Park leftover entry until the next rebuild
+    if (store->stashed < store->stash_size)
+    {
+        store->stash[store->stashed++] = *entry;
+        if (placed) *placed = first;
+        return 1;
+    }
+
+    return 0;
+}
+
+// Move every entry of old storage and extra (may be NULL) returning 0 if placement failed
+// Entries keep their table hash so no key is hashed again
+static int _cuckoo_move(cuckoo_t* store, const cuckoo_t* old, const entry_t* extra)
+{
+    for (uint32_t i = 0; i < old->nbuckets; i++)
+    {
+        const cuckoo_bucket_t* bucket = &old->buckets[i];
+
+        for (uint32_t w = 0; w < CUCKOO_WAYS; w++)
+        {
+            if (!(bucket->used >> w & 1)) continue;
+
+            entry_t entry = { bucket->key[w], bucket->data[w], bucket->hash[w] };
+            if (!_cuckoo_place(store, &entry, NULL)) return 0;
+        }
+    }
+
+    for (uint32_t s = 0; s < old->stashed; s++)
+    {
+        entry_t entry = old->stash[s];
+        if (!_cuckoo_place(store, &entry, NULL)) return 0;
+    }
+
+    if (extra)
+    {
+        entry_t entry = *extra;
+        if (!_cuckoo_place(store, &entry, NULL)) return 0;
+    }
+
+    return 1;
+}
+
+// Rebuild storage with fresh seeds and specified number of buckets also placing extra (may be NULL)
+static void _cuckoo_rehash(hash_t* table, uint32_t nbuckets, const entry_t* extra)
+{
+    cuckoo_t* store = (cuckoo_t*) table->store;
+    const cuckoo_t old = *store;
+
+    // Stash starts large enough for the entries parked so far
+    uint32_t stash_size = MAX(_up2(old.stashed + 1), CUCKOO_STASH);
+
+    for (uint32_t attempt = 1; ; attempt++)
+    {
+        _cuckoo_alloc(store, nbuckets, stash_size);
+        store->seed[0] = _cuckoo_rand(store);
+        store->seed[1] = _cuckoo_rand(store);
+
+        if (_cuckoo_move(store, &old, extra)) break;
+
+        free(store->buckets);
+        free(store->stash);
+
+        // Early failures mean the table is too dense for two choices, later ones that keys share
+        // table hashes which no seed separates, so the stash grows until it holds them
+        if (attempt < CUCKOO_MAX_REHASH)
+        {
+            if (!(attempt % 4)) nbuckets *= 2;
+        }
+        else stash_size *= 2;
+    }
+
+    free(old.buckets);
+    free(old.stash);
+
+    table->size = nbuckets * CUCKOO_WAYS;
+}
+
+// Move stashed entries back into buckets with free ways
+static void _cuckoo_unstash(cuckoo_t* store)
+{
+    for (uint32_t s = 0; s < store->stashed; )
+    {
+        const entry_t* entry = &store->stash[s];
+
+        uint32_t b[2];
+        _cuckoo_buckets(store, entry->hash, b);
+
+        if (_cuckoo_put(&store->buckets[b[0]], entry) >= 0 || _cuckoo_put(&store->buckets[b[1]], entry) >= 0)
+        {
+            store->stash[s] = store->stash[--store->stashed];
+        }
+        else s++;
+    }
+}
+
+
+// Initialize cuckoo storage
+static void _cuckoo_init(hash_t* table, uint32_t size)
+{
+    cuckoo_t* store = (cuckoo_t*) malloc(sizeof(cuckoo_t));
+
+    // Size so that requested entries fit below the maximum load factor
+    const uint64_t slots = (uint64_t) size * CUCKOO_LOAD_DEN / CUCKOO_LOAD_NUM;
+    const uint32_t nbuckets = MAX(_up2((slots + CUCKOO_WAYS - 1) / CUCKOO_WAYS), CUCKOO_MIN_BUCKETS);
+    _cuckoo_alloc(store, nbuckets, CUCKOO_STASH);
+
+    store->state = HASH_SEED;
+    store->seed[0] = HASH_SEED;
+    store->seed[1] = ~HASH_SEED;
+
+    table->store = store;
+    table->entries = 0;
+    table->size = nbuckets * CUCKOO_WAYS;
+}
+
+
+// Cleanup and deallocate cuckoo storage
+static void _cuckoo_free(hash_t* table, void (*keyfree)(const void*), void (*datafree)(const void*))
+{
+    cuckoo_t* store = (cuckoo_t*) table->store;
+
+    // Free key and data if free functions are provided
+    if (keyfree || datafree)
+    {
+        for (uint32_t i = 0; i < store->nbuckets; i++)
+        {
+            const cuckoo_bucket_t* bucket = &store->buckets[i];
+
+            for (uint32_t w = 0; w < CUCKOO_WAYS; w++)
+            {
+                if (!(bucket->used >> w & 1)) continue;
+
+                if (keyfree) keyfree(bucket->key[w]);
+                if (datafree) datafree(bucket->data[w]);
+            }
+        }
+
+        for (uint32_t s = 0; s < store->stashed; s++)
+        {
+            if (keyfree) keyfree(store->stash[s].key);
+            if (datafree) datafree(store->stash[s].data);
+        }
+    }
+
+    free(store->buckets);
+    free(store->stash);
+    free(store);
+    table->store = NULL;
+}
+
+
+// Return data slot of entry with specified key inserting it with NULL data if absent O(1) amortized
+static const void** _cuckoo_find_or_insert(hash_t* table, const void* key, uint32_t hash, int* inserted)
+{
+    cuckoo_t* store = (cuckoo_t*) table->store;
+
+    uint32_t b[2];
+    _cuckoo_buckets(store, hash, b);
+
+    // Return existing entry (duplicates not allowed!)
+    int64_t slot = _cuckoo_find(table, store, key, hash, b);
+    *inserted = slot < 0;
+    if (slot >= 0) return _cuckoo_data(store, slot);
+
+    // Resize table if necessary
+    if (table->entries >= store->limit) _cuckoo_rehash(table, store->nbuckets * 2, NULL);
+
+    // The new entry keeps the slot it was placed in while displacement moves others
+    entry_t entry = { key, NULL, hash };
+    uint64_t placed;
+
+    if (!_cuckoo_place(store, &entry, &placed))
+    {
+        // Rebuild with new seeds placing the leftover entry as well so the new entry is probed again
+        _cuckoo_rehash(table, store->nbuckets, &entry);
+        _cuckoo_buckets(store, hash, b);
+        placed = _cuckoo_find(table, store, key, hash, b);
+    }
+
+    table->entries++;
+
+    return _cuckoo_data(store, placed);
+}
+
+
+// Insert new entry into cuckoo storage O(1) amortized
+static void _cuckoo_insert(hash_t* table, const void* key, const void* data, uint32_t hash)
+{
+    int inserted;
+    *_cuckoo_find_or_insert(table, key, hash, &inserted) = data;
+}
+
+
+// Return data of the entry with specified key O(1) worst case
+static void* _cuckoo_search(const hash_t* table, const void* key, uint32_t hash)
+{
+    cuckoo_t* store = (cuckoo_t*) table->store;
+
+    uint32_t b[2];
+    _cuckoo_buckets(store, hash, b);
+
+    const int64_t slot = _cuckoo_find(table, store, key, hash, b);
+
+    return slot >= 0 ? (void*) *_cuckoo_data(store, slot) : NULL;
+}
+
+
+// Remove entry with specified key returning data O(1) worst case
+static void* _cuckoo_remove(hash_t* table, const void* key, uint32_t hash)
+{
+    cuckoo_t* store = (cuckoo_t*) table->store;
+
+    uint32_t b[2];
+    _cuckoo_buckets(store, hash, b);
+
+    const int64_t slot = _cuckoo_find(table, store, key, hash, b);
+    if (slot < 0) return NULL;
+
+    void* data = (void*) *_cuckoo_data(store, slot);
+    const uint64_t n = (uint64_t) store->nbuckets * CUCKOO_WAYS;
+
+    if ((uint64_t) slot < n)
+    {
+        store->buckets[slot / CUCKOO_WAYS].used &= ~(1 << (slot % CUCKOO_WAYS));
+        if (store->stashed) _cuckoo_unstash(store);
+    }
+    else
+    {
+        store->stash[slot - n] = store->stash[--store->stashed];
+    }
+
+    table->entries--;
+
+    // Resize table if necessary
+    if (store->nbuckets > CUCKOO_MIN_BUCKETS && table->entries < n / 8) _cuckoo_rehash(table, store->nbuckets / 2, NULL);
+
+    return data;
+}
+
+
+// Prefetch both candidate buckets of hash (each is a single cache line)
+static void _cuckoo_prefetch(const hash_t* table, uint32_t hash, int stage)
+{
+    const cuckoo_t* store = (const cuckoo_t*) table->store;
+    if (stage) return;
+
+    uint32_t b[2];
+    _cuckoo_buckets(store, hash, b);
+
+    __builtin_prefetch(&store->buckets[b[0]]);
+    __builtin_prefetch(&store->buckets[b[1]]);
+}
+
+
+// Print cuckoo storage statistics
+static void _cuckoo_print_stats(const hash_t* table)
+{
+    const cuckoo_t* store = (const cuckoo_t*) table->store;
+
+    uint64_t primary = 0;
+    uint32_t b[2];
+
+    for (uint32_t i = 0; i < store->nbuckets; i++)
+    {
+        const cuckoo_bucket_t* bucket = &store->buckets[i];
+
+        for (uint32_t w = 0; w < CUCKOO_WAYS; w++)
+        {
+            if (!(bucket->used >> w & 1)) continue;
+
+            _cuckoo_buckets(store, bucket->hash[w], b);
+            if (b[0] == i) primary++;
+        }
+    }
+
+    printf("entries: %zu, size: %zu, alpha %.2f\n", (size_t) table->entries, (size_t) table->size, (float) table->entries / table->size);
+    printf("buckets: %zu, primary: %.2f%%, stashed: %zu\n", (size_t) store->nbuckets, table->entries ? 100.0f * primary / table->entries : 0.0f, (size_t) store->stashed);
+    printf("approximate overhead in bytes: %zu\n", (size_t) store->nbuckets * sizeof(cuckoo_bucket_t) + (size_t) store->stash_size * sizeof(entry_t) + sizeof(cuckoo_t) + sizeof(hash_t));
+}
+
+
+// Visualize cuckoo storage one bucket per line
+static void _cuckoo_print_debug(const hash_t* table)
+{
+    const cuckoo_t* store = (const cuckoo_t*) table->store;
+
+    for (uint32_t i = 0; i < store->nbuckets; i++)
+    {
+        printf("[%zu] ", (size_t) i);
+        for (uint32_t w = 0; w < CUCKOO_WAYS; w++) printf("%c", store->buckets[i].used >> w & 1 ? '*' : '.');
+        printf("\n");
+    }
+
+    printf("[stash] ");
+    for (uint32_t s = 0; s < store->stashed; s++) printf("*");
+    printf("\n");
+}
+
+
+const hash_backend_t hash_backend_cuckoo =
+{
+    "cuckoo",
+    _cuckoo_init,
+    _cuckoo_free,
+    _cuckoo_insert,
+    _cuckoo_find_or_insert,
+    _cuckoo_search,
+    _cuckoo_remove,
+    _cuckoo_prefetch,
+    _cuckoo_print_stats,
+    _cuckoo_print_debug,
+};
@@ -0,0 +1,295 @@
+// hash-robin.c
+// kpadron.github@gmail.com
+// Kristian Padron
+// robin hood linear probing hash table backend
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hash-table.h"
+
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+// Smallest slot array allocated
+#define ROBIN_MIN_SIZE 8
+
+// Maximum load factor is ROBIN_LOAD_NUM / ROBIN_LOAD_DEN
+#define ROBIN_LOAD_NUM 19
+#define ROBIN_LOAD_DEN 20
+
+
+// Object representing a robin hood slot (dist is probe distance + 1, 0 when empty)
+typedef struct
+{
+    const void* key;
+    const void* data;
+    uint32_t hash;
+    uint32_t dist;
+} robin_slot_t;
+
+// Object representing robin hood storage
+typedef struct
+{
+    uint32_t capacity;
+    uint32_t limit;
+    robin_slot_t* slots;
+} robin_t;
+
+
+// Compute the next highest power of 2
+static inline uint32_t _up2(uint32_t x)
+{
+    x--;
+    x |= x >> 1;
+    x |= x >> 2;
+    x |= x >> 4;
+    x |= x >> 8;
+    x |= x >> 16;
+    x++;
+    return x + (x == 0);
+}
+
+// Allocate empty storage with specified capacity
+static void _robin_alloc(robin_t* store, uint32_t capacity)
+{
+    store->capacity = capacity;
+    store->limit = (uint64_t) capacity * ROBIN_LOAD_NUM / ROBIN_LOAD_DEN;
+    store->slots = (robin_slot_t*) calloc(capacity, sizeof(robin_slot_t));
+}
+
+// Return slot index of entry with specified key or -1
+static int64_t _robin_find(const hash_t* table, const robin_t* store, const void* key, uint32_t hash)
+{
+    const uint32_t mask = store->capacity - 1;
+
+    for (uint32_t i = hash & mask, dist = 1; ; i = (i + 1) & mask, dist++)
+    {
+        const robin_slot_t* slot = &store->slots[i];
+
+        // Key would have displaced any entry closer to its home slot
+        if (slot->dist < dist) return -1;
+
+        if (slot->hash == hash && !table->keycmp(key, slot->key)) return i;
+    }
+}
+
+// Place entry known to be absent into storage stealing from richer slots returning its slot
+static uint32_t _robin_place(robin_t* store, robin_slot_t entry)
+{
+    const uint32_t mask = store->capacity - 1;
+
+    // Only displaced entries move once the new entry is stored
+    uint32_t placed = UINT32_MAX;
+
+    entry.dist = 1;
+
+    for (uint32_t i = entry.hash & mask; ; i = (i + 1) & mask, entry.dist++)
+    {
+        robin_slot_t* slot = &store->slots[i];
+
+        if (!slot->dist)
+        {
+            *slot = entry;
+            return placed == UINT32_MAX ? i : placed;
+        }
+
+        // Swap with entry that is closer to its home slot
+        if (slot->dist < entry.dist)
+        {
+            const robin_slot_t swap = *slot;
+            *slot = entry;
+            entry = swap;
+
+            if (placed == UINT32_MAX) placed = i;
+        }
+    }
+}
+
+// Move all entries into storage of specified capacity
+static void _robin_rehash(hash_t* table, uint32_t capacity)
+{
+    robin_t* store = (robin_t*) table->store;
+    robin_t old = *store;
+
+    _robin_alloc(store, capacity);
+
+    // Stored hashes avoid rehashing keys
+    for (uint32_t i = 0; i < old.capacity; i++)
+    {
+        if (old.slots[i].dist) _robin_place(store, old.slots[i]);
+    }
+
+    free(old.slots);
+
+    table->size = capacity;
+}
+
+
+// Initialize robin hood storage
+static void _robin_init(hash_t* table, uint32_t size)
+{
+    robin_t* store = (robin_t*) malloc(sizeof(robin_t));
+
+    // Size so that requested entries fit below the maximum load factor
+    const uint32_t capacity = MAX(_up2((uint64_t) size * ROBIN_LOAD_DEN / ROBIN_LOAD_NUM + 1), ROBIN_MIN_SIZE);
+    _robin_alloc(store, capacity);
+
+    table->store = store;
+    table->entries = 0;
+    table->size = capacity;
+}
+
+
+// Cleanup and deallocate robin hood storage
+static void _robin_free(hash_t* table, void (*keyfree)(const void*), void (*datafree)(const void*))
+{
+    robin_t* store = (robin_t*) table->store;
+
+    // Free key and data if free functions are provided
+    if (keyfree || datafree)
+    {
+        for (uint32_t i = 0; i < store->capacity; i++)
+        {
+            if (!store->slots[i].dist) continue;
+
+            if (keyfree) keyfree(store->slots[i].key);
+            if (datafree) datafree(store->slots[i].data);
+        }
+    }
+
+    free(store->slots);
+    free(store);
+    table->store = NULL;
+}
+
+
+// Return data slot of entry with specified key inserting it with NULL data if absent O(1)
+static const void** _robin_find_or_insert(hash_t* table, const void* key, uint32_t hash, int* inserted)
+{
+    robin_t* store = (robin_t*) table->store;
+
+    // Return existing entry (duplicates not allowed!)
+    const int64_t index = _robin_find(table, store, key, hash);
+    *inserted = index < 0;
+    if (index >= 0) return &store->slots[index].data;
+
+    // Resize table if necessary
+    if (table->entries >= store->limit) _robin_rehash(table, store->capacity * 2);
+
+    const robin_slot_t entry = { key, NULL, hash, 0 };
+    table->entries++;
+
+    return &store->slots[_robin_place(store, entry)].data;
+}
+
+
+// Insert new entry into robin hood storage O(1)
+static void _robin_insert(hash_t* table, const void* key, const void* data, uint32_t hash)
+{
+    int inserted;
+    *_robin_find_or_insert(table, key, hash, &inserted) = data;
+}
+
+
+// Return data of the entry with specified key O(1)
+static void* _robin_search(const hash_t* table, const void* key, uint32_t hash)
+{
+    const robin_t* store = (const robin_t*) table->store;
+
+    const int64_t index = _robin_find(table, store, key, hash);
+
+    return index >= 0 ? (void*) store->slots[index].data : NULL;
+}
+
+
+// Remove entry with specified key returning data O(1)
+static void* _robin_remove(hash_t* table, const void* key, uint32_t hash)
+{
+    robin_t* store = (robin_t*) table->store;
+    const uint32_t mask = store->capacity - 1;
+
+    const int64_t index = _robin_find(table, store, key, hash);
+    if (index < 0) return NULL;
+
+    void* data = (void*) store->slots[index].data;
+
+    // Shift following displaced entries back one slot (no tombstones)
+    uint32_t i = index;
+    for (uint32_t j = (i + 1) & mask; store->slots[j].dist > 1; i = j, j = (j + 1) & mask)
+    {
+        store->slots[i] = store->slots[j];
+        store->slots[i].dist--;
+    }
+
+    store->slots[i].dist = 0;
+    table->entries--;
+
+    // Resize table if necessary
+    if (store->capacity > ROBIN_MIN_SIZE && table->entries < store->capacity / 4) _robin_rehash(table, store->capacity / 2);
+
+    return data;
+}
+
+
+// Prefetch home slot of hash (probing continues in the same or next lines)
+static void _robin_prefetch(const hash_t* table, uint32_t hash, int stage)
+{
+    const robin_t* store = (const robin_t*) table->store;
+
+    if (!stage) __builtin_prefetch(&store->slots[hash & (store->capacity - 1)]);
+}
+
+
+// Print robin hood storage statistics
+static void _robin_print_stats(const hash_t* table)
+{
+    const robin_t* store = (const robin_t*) table->store;
+
+    uint32_t max = 0;
+    uint64_t sum = 0;
+
+    for (uint32_t i = 0; i < store->capacity; i++)
+    {
+        const uint32_t dist = store->slots[i].dist;
+        if (!dist) continue;
+
+        max = MAX(dist - 1, max);
+        sum += dist - 1;
+    }
+
+    printf("entries: %zu, size: %zu, alpha %.2f\n", (size_t) table->entries, (size_t) store->capacity, (float) table->entries / store->capacity);
+    printf("avg-probe: %.2f, max-probe: %zu\n", table->entries ? (float) sum / table->entries : 0.0f, (size_t) max);
+    printf("approximate overhead in bytes: %zu\n", (size_t) store->capacity * sizeof(robin_slot_t) + sizeof(robin_t) + sizeof(hash_t));
+}
+
+
+// Visualize robin hood storage with probe distance per slot
+static void _robin_print_debug(const hash_t* table)
+{
+    const robin_t* store = (const robin_t*) table->store;
+
+    for (uint32_t i = 0; i < store->capacity; i++)
+    {
+        const uint32_t dist = store->slots[i].dist;
+
+        printf("[%zu] ", (size_t) i);
+        if (dist) printf("%zu", (size_t) dist - 1);
+        printf("\n");
+    }
+}
+
+
+const hash_backend_t hash_backend_robin =
+{
+    "robin",
+    _robin_init,
+    _robin_free,
+    _robin_insert,
+    _robin_find_or_insert,
+    _robin_search,
+    _robin_remove,
+    _robin_prefetch,
+    _robin_print_stats,
+    _robin_print_debug,
+};
@@ -0,0 +1,316 @@
+// hash-sharded.c
+// kpadron.github@gmail.com
+// Kristian Padron
+// hash table split into independently locked and resized shards
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "hash.h"
+#include "hash-sharded.h"
+
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+
+// Object representing state shared by the threads of a parallel build
+typedef struct
+{
+    hash_sharded_t* table;
+    const void* const* keys;
+    const void* const* data;
+    size_t n;
+    uint32_t threads;
+
+    uint32_t* hashes;
+    size_t* order;
+    size_t* offsets;
+    pthread_barrier_t barrier;
+    pthread_mutex_t gate;
+} hash_build_t;
+
+// Object representing one thread of a parallel build
+typedef struct
+{
+    hash_build_t* build;
+    uint32_t id;
+    pthread_t thread;
+} hash_builder_t;
+
+
+// Compute the next highest power of 2
+static inline uint32_t _up2(uint32_t x)
+{
+    x--;
+    x |= x >> 1;
+    x |= x >> 2;
+    x |= x >> 4;
+    x |= x >> 8;
+    x |= x >> 16;
+    x++;
+    return x + (x == 0);
+}
+
+// Compute hash of key (keysize may be omitted for fixed width hashes)
+static inline uint32_t _hash_key(const hash_sharded_t* table, const void* key)
+{
+    return table->keyhash(key, table->keysize ? table->keysize(key) : 0);
+}
+
+// Return shard owning hash
+static inline uint32_t _shard_index(const hash_sharded_t* table, uint32_t hash)
+{
+    return table->bits ? hash >> (32 - table->bits) : 0;
+}
+
+// Return hash used inside a shard (odd multiply is reversible and spreads the fixed high bits)
+static inline uint32_t _shard_hash(uint32_t hash)
+{
+    return hash * 0x9E3779B1;
+}
+
+
+// Initalize a sharded hash table object
+void hash_sharded_init(hash_sharded_t* table, uint32_t shards, uint32_t size, size_t (*keysize)(const void*), int (*keycmp)(const void*, const void*), uint32_t (*keyhash)(const void*, size_t), uint32_t (*hashmap)(uint32_t, uint32_t))
+{
+    if (!table) return;
+
+    // Initialize table functions
+    table->keysize = keysize;
+    table->keyhash = keyhash ? keyhash : hash_fnv1a;
+
+    table->count = _up2(shards ? shards : HASH_SHARDS);
+    table->bits = __builtin_ctz(table->count);
+    table->shards = (hash_shard_t*) aligned_alloc(_Alignof(hash_shard_t), table->count * sizeof(hash_shard_t));
+
+    for (uint32_t i = 0; i < table->count; i++)
+    {
+        hash_shard_t* shard = &table->shards[i];
+
+        pthread_mutex_init(&shard->lock, NULL);
+        hash_init(&shard->table, MAX(size / table->count, 1), keysize, keycmp, keyhash, hashmap);
+    }
+}
+
+
+// Cleanup and deallocate a sharded hash table object
+void hash_sharded_free(hash_sharded_t* table, void (*keyfree)(const void*), void (*datafree)(const void*))
+{
+    if (!table) return;
+
+    for (uint32_t i = 0; i < table->count; i++)
+    {
+        hash_shard_t* shard = &table->shards[i];
+
+        hash_free(&shard->table, keyfree, datafree);
+        pthread_mutex_destroy(&shard->lock);
+    }
+
+    free(table->shards);
+    table->shards = NULL;
+}
+
+
+// Insert new entry locking only the shard of key O(1)
+void hash_sharded_insert(hash_sharded_t* table, const void* key, const void* data)
+{
+    if (!table) return;
+
+    const uint32_t hash = _hash_key(table, key);
+    hash_shard_t* shard = &table->shards[_shard_index(table, hash)];
+
+    // Only this shard can resize while the lock is held
+    pthread_mutex_lock(&shard->lock);
+    shard->table.backend->insert(&shard->table, key, data, _shard_hash(hash));
+    pthread_mutex_unlock(&shard->lock);
+}
+
+
+// Return data of the entry with specified key locking only its shard O(1)
+void* hash_sharded_search(hash_sharded_t* table, const void* key)
+{
+    if (!table) return NULL;
+
+    const uint32_t hash = _hash_key(table, key);
+    hash_shard_t* shard = &table->shards[_shard_index(table, hash)];
+    void* data = NULL;
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->table.entries) data = shard->table.backend->search(&shard->table, key, _shard_hash(hash));
+    pthread_mutex_unlock(&shard->lock);
+
+    return data;
+}
+
+
+// Remove entry with specified key locking only its shard returning data O(1)
+void* hash_sharded_remove(hash_sharded_t* table, const void* key)
+{
+    if (!table) return NULL;
+
+    const uint32_t hash = _hash_key(table, key);
+    hash_shard_t* shard = &table->shards[_shard_index(table, hash)];
+    void* data = NULL;
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->table.entries) data = shard->table.backend->remove(&shard->table, key, _shard_hash(hash));
+    pthread_mutex_unlock(&shard->lock);
+
+    return data;
+}
+
+
+// Hash a slice, group it by shard, then insert the groups of shards this thread owns
+static void* _sharded_build_worker(void* arg)
+{
+    const hash_builder_t* builder = (const hash_builder_t*) arg;
+    hash_build_t* build = builder->build;
+    hash_sharded_t* table = build->table;
+
+    // Wait until the number of builders is final
+    pthread_mutex_lock(&build->gate);
+    pthread_mutex_unlock(&build->gate);
+
+    const uint32_t id = builder->id;
+    const uint32_t shards = table->count;
+    const size_t begin = build->n * id / build->threads;
+    const size_t end = build->n * (id + 1) / build->threads;
+
+    // Offsets are laid out shard major so each shard's entries end up contiguous
+    size_t* offsets = build->offsets;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        build->hashes[i] = _hash_key(table, build->keys[i]);
+        offsets[(size_t) _shard_index(table, build->hashes[i]) * build->threads + id]++;
+    }
+
+    // One thread turns counts into starting positions
+    if (pthread_barrier_wait(&build->barrier) == PTHREAD_BARRIER_SERIAL_THREAD)
+    {
+        size_t sum = 0;
+        for (size_t i = 0; i < (size_t) shards * build->threads; i++)
+        {
+            const size_t count = offsets[i];
+            offsets[i] = sum;
+            sum += count;
+        }
+    }
+
+    pthread_barrier_wait(&build->barrier);
+
+    for (size_t i = begin; i < end; i++)
+    {
+        build->order[offsets[(size_t) _shard_index(table, build->hashes[i]) * build->threads + id]++] = i;
+    }
+
+    pthread_barrier_wait(&build->barrier);
+
+    // Each shard is filled by one thread in input order so no two threads share a shard
+    for (uint32_t s = id; s < shards; s += build->threads)
+    {
+        hash_shard_t* shard = &table->shards[s];
+        const size_t first = s ? offsets[(size_t) s * build->threads - 1] : 0;
+        const size_t last = offsets[(size_t) (s + 1) * build->threads - 1];
+
+        pthread_mutex_lock(&shard->lock);
+        for (size_t j = first; j < last; j++)
+        {
+            const size_t i = build->order[j];
+            shard->table.backend->insert(&shard->table, build->keys[i], build->data[i], _shard_hash(build->hashes[i]));
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return NULL;
+}
+
+
+// Insert n entries using specified threads that each own a subset of shards
+void hash_sharded_build(hash_sharded_t* table, const void* const* keys, const void* const* data, size_t n, uint32_t threads)
+{
+    if (!table || !n) return;
+
+    hash_build_t build;
+    build.table = table;
+    build.keys = keys;
+    build.data = data;
+    build.n = n;
+    build.hashes = (uint32_t*) malloc(n * sizeof(uint32_t));
+    build.order = (size_t*) malloc(n * sizeof(size_t));
+    pthread_mutex_init(&build.gate, NULL);
+
+    threads = MIN(MAX(threads, 1), table->count);
+    hash_builder_t* builders = (hash_builder_t*) malloc(threads * sizeof(hash_builder_t));
+
+    // Builders wait at the gate so those that could not be created leave their shards to the rest
+    pthread_mutex_lock(&build.gate);
+
+    uint32_t spawned = 1;
+    for (; spawned < threads; spawned++)
+    {
+        builders[spawned].build = &build;
+        builders[spawned].id = spawned;
+        if (pthread_create(&builders[spawned].thread, NULL, _sharded_build_worker, &builders[spawned])) break;
+    }
+
+    build.threads = spawned;
+    build.offsets = (size_t*) calloc((size_t) table->count * build.threads, sizeof(size_t));
+    pthread_barrier_init(&build.barrier, NULL, build.threads);
+
+    pthread_mutex_unlock(&build.gate);
+
+    // Calling thread works as builder 0
+    builders[0].build = &build;
+    builders[0].id = 0;
+    _sharded_build_worker(&builders[0]);
+
+    for (uint32_t i = 1; i < build.threads; i++) pthread_join(builders[i].thread, NULL);
+
+    pthread_barrier_destroy(&build.barrier);
+    pthread_mutex_destroy(&build.gate);
+    free(builders);
+    free(build.offsets);
+    free(build.order);
+    free(build.hashes);
+}
+
+
+// Return total entries
+uint64_t hash_sharded_entries(const hash_sharded_t* table)
+{
+    if (!table) return 0;
+
+    uint64_t entries = 0;
+    for (uint32_t i = 0; i < table->count; i++) entries += table->shards[i].table.entries;
+
+    return entries;
+}
+
+
+// Print table statistics
+void hash_sharded_print_stats(hash_sharded_t* table)
+{
+    if (!table) return;
+
+    uint64_t entries = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+    uint32_t largest = 0;
+
+    for (uint32_t i = 0; i < table->count; i++)
+    {
+        hash_shard_t* shard = &table->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+        entries += shard->table.entries;
+        min = MIN(shard->table.entries, min);
+        max = MAX(shard->table.entries, max);
+        largest = MAX(shard->table.size, largest);
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    printf("entries: %zu, shards: %zu, shard entries min: %zu, max: %zu, largest shard size: %zu\n", (size_t) entries, (size_t) table->count, (size_t) min, (size_t) max, (size_t) largest);
+}
@@ -0,0 +1,357 @@
+// hash-swiss.c
+// kpadron.github@gmail.com
+// Kristian Padron
+// open addressing hash table backend with SIMD probed control groups
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hash-table.h"
+
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+// Slots per control group (one SSE2 register of tags)
+#define SWISS_GROUP 16
+
+// Maximum load factor is SWISS_LOAD_NUM / SWISS_LOAD_DEN
+#define SWISS_LOAD_NUM 7
+#define SWISS_LOAD_DEN 8
+
+// Control byte values (full slots hold a 7-bit tag with high bit clear)
+#define SWISS_EMPTY ((uint8_t) 0x80)
+#define SWISS_DELETED ((uint8_t) 0xFE)
+
+
+// Object representing open addressing storage
+typedef struct
+{
+    uint32_t capacity;
+    uint32_t growth;
+    uint32_t deleted;
+    uint8_t* ctrl;
+    entry_t* slots;
+} swiss_t;
+
+
+// Compute the next highest power of 2
+static inline uint32_t _up2(uint32_t x)
+{
+    x--;
+    x |= x >> 1;
+    x |= x >> 2;
+    x |= x >> 4;
+    x |= x >> 8;
+    x |= x >> 16;
+    x++;
+    return x + (x == 0);
+}
+
+// Return 7-bit tag stored in control bytes
+static inline uint8_t _swiss_h2(uint32_t hash)
+{
+    return hash & 0x7F;
+}
+
+// Return starting group of probe sequence
+static inline uint32_t _swiss_h1(uint32_t hash)
+{
+    return hash >> 7;
+}
+
+// Return bitmask of slots in group whose tag matches
+static inline uint32_t _swiss_match(const uint8_t* group, uint8_t tag)
+{
+#if defined(__SSE2__)
+    const __m128i ctrl = _mm_load_si128((const __m128i*) group);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < SWISS_GROUP; i++) mask |= (uint32_t) (group[i] == tag) << i;
+    return mask;
+#endif
+}
+
+// Return bitmask of slots in group that are empty or deleted
+static inline uint32_t _swiss_match_free(const uint8_t* group)
+{
+#if defined(__SSE2__)
+    return _mm_movemask_epi8(_mm_load_si128((const __m128i*) group));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < SWISS_GROUP; i++) mask |= (uint32_t) (group[i] >> 7) << i;
+    return mask;
+#endif
+}
+
+// Return usable slots for specified capacity
+static inline uint32_t _swiss_growth(uint32_t capacity)
+{
+    return (uint64_t) capacity * SWISS_LOAD_NUM / SWISS_LOAD_DEN;
+}
+
+
+// Allocate empty storage with specified capacity
+static void _swiss_alloc(swiss_t* store, uint32_t capacity)
+{
+    store->capacity = capacity;
+    store->growth = _swiss_growth(capacity);
+    store->deleted = 0;
+    store->ctrl = (uint8_t*) aligned_alloc(SWISS_GROUP, capacity);
+    store->slots = (entry_t*) malloc(capacity * sizeof(entry_t));
+
+    memset(store->ctrl, SWISS_EMPTY, capacity);
+}
+
+// Return slot index of entry with specified key or -1
+static int64_t _swiss_find(const hash_t* table, const swiss_t* store, const void* key, uint32_t hash)
+{
+    const uint32_t mask = store->capacity / SWISS_GROUP - 1;
+    const uint8_t tag = _swiss_h2(hash);
+
+    // Triangular probing visits every group when group count is a power of 2
+    for (uint32_t g = _swiss_h1(hash) & mask, step = 1; ; g = (g + step++) & mask)
+    {
+        const uint8_t* group = &store->ctrl[g * SWISS_GROUP];
+
+        for (uint32_t match = _swiss_match(group, tag); match; match &= match - 1)
+        {
+            const uint32_t slot = g * SWISS_GROUP + __builtin_ctz(match);
+
+            if (store->slots[slot].hash == hash && !table->keycmp(key, store->slots[slot].key)) return slot;
+        }
+
+        // An empty slot terminates the probe sequence
+        if (_swiss_match(group, SWISS_EMPTY)) return -1;
+    }
+}
+
+// Return first empty or deleted slot on probe sequence
+static uint32_t _swiss_find_free(const swiss_t* store, uint32_t hash)
+{
+    const uint32_t mask = store->capacity / SWISS_GROUP - 1;
+
+    for (uint32_t g = _swiss_h1(hash) & mask, step = 1; ; g = (g + step++) & mask)
+    {
+        const uint32_t match = _swiss_match_free(&store->ctrl[g * SWISS_GROUP]);
+
+        if (match) return g * SWISS_GROUP + __builtin_ctz(match);
+    }
+}
+
+// Place entry known to be absent into storage returning its slot
+static uint32_t _swiss_place(swiss_t* store, const void* key, const void* data, uint32_t hash)
+{
+    const uint32_t slot = _swiss_find_free(store, hash);
+
+    if (store->ctrl[slot] == SWISS_EMPTY) store->growth--;
+    else store->deleted--;
+
+    store->ctrl[slot] = _swiss_h2(hash);
+    store->slots[slot].key = key;
+    store->slots[slot].data = data;
+    store->slots[slot].hash = hash;
+
+    return slot;
+}
+
+// Move all entries into storage of specified capacity
+static void _swiss_rehash(hash_t* table, uint32_t capacity)
+{
+    swiss_t* store = (swiss_t*) table->store;
+    swiss_t old = *store;
+
+    _swiss_alloc(store, capacity);
+
+    for (uint32_t i = 0; i < old.capacity; i++)
+    {
+        if (old.ctrl[i] & 0x80) continue;
+
+        // Reuse stored hash instead of rehashing the key
+        const entry_t* entry = &old.slots[i];
+        _swiss_place(store, entry->key, entry->data, entry->hash);
+    }
+
+    free(old.ctrl);
+    free(old.slots);
+
+    table->size = capacity;
+}
+
+
+// Initialize open addressing storage
+static void _swiss_init(hash_t* table, uint32_t size)
+{
+    swiss_t* store = (swiss_t*) malloc(sizeof(swiss_t));
+
+    // Size so that requested entries fit below the maximum load factor
+    const uint32_t capacity = MAX(_up2((uint64_t) size * SWISS_LOAD_DEN / SWISS_LOAD_NUM), SWISS_GROUP);
+    _swiss_alloc(store, capacity);
+
+    table->store = store;
+    table->entries = 0;
+    table->size = capacity;
+}
+
+
+// Cleanup and deallocate open addressing storage
+static void _swiss_free(hash_t* table, void (*keyfree)(const void*), void (*datafree)(const void*))
+{
+    swiss_t* store = (swiss_t*) table->store;
+
+    // Free key and data if free functions are provided
+    if (keyfree || datafree)
+    {
+        for (uint32_t i = 0; i < store->capacity; i++)
+        {
+            if (store->ctrl[i] & 0x80) continue;
+
+            if (keyfree) keyfree(store->slots[i].key);
+            if (datafree) datafree(store->slots[i].data);
+        }
+    }
+
+    free(store->ctrl);
+    free(store->slots);
+    free(store);
+    table->store = NULL;
+}
+
+
+// Return data slot of entry with specified key inserting it with NULL data if absent O(1)
+static const void** _swiss_find_or_insert(hash_t* table, const void* key, uint32_t hash, int* inserted)
+{
+    swiss_t* store = (swiss_t*) table->store;
+
+    // Return existing entry (duplicates not allowed!)
+    const int64_t slot = _swiss_find(table, store, key, hash);
+    *inserted = slot < 0;
+    if (slot >= 0) return &store->slots[slot].data;
+
+    // Grow when full, or rebuild in place when tombstones consume the headroom
+    if (!store->growth)
+    {
+        const uint32_t capacity = table->entries >= _swiss_growth(store->capacity) / 2 ? store->capacity * 2 : store->capacity;
+        _swiss_rehash(table, capacity);
+    }
+
+    table->entries++;
+
+    return &store->slots[_swiss_place(store, key, NULL, hash)].data;
+}
+
+
+// Insert new entry into open addressing storage O(1)
+static void _swiss_insert(hash_t* table, const void* key, const void* data, uint32_t hash)
+{
+    int inserted;
+    *_swiss_find_or_insert(table, key, hash, &inserted) = data;
+}
+
+
+// Return data of the entry with specified key O(1)
+static void* _swiss_search(const hash_t* table, const void* key, uint32_t hash)
+{
+    const swiss_t* store = (const swiss_t*) table->store;
+
+    const int64_t slot = _swiss_find(table, store, key, hash);
+
+    return slot >= 0 ? (void*) store->slots[slot].data : NULL;
+}
+
+
+// Remove entry with specified key returning data O(1)
+static void* _swiss_remove(hash_t* table, const void* key, uint32_t hash)
+{
+    swiss_t* store = (swiss_t*) table->store;
+
+    const int64_t slot = _swiss_find(table, store, key, hash);
+    if (slot < 0) return NULL;
+
+    void* data = (void*) store->slots[slot].data;
+    const uint8_t* group = &store->ctrl[slot & ~(int64_t) (SWISS_GROUP - 1)];
+
+    // Probe sequences never continued past a group with an empty slot
+    if (_swiss_match(group, SWISS_EMPTY))
+    {
+        store->ctrl[slot] = SWISS_EMPTY;
+        store->growth++;
+    }
+    else
+    {
+        store->ctrl[slot] = SWISS_DELETED;
+        store->deleted++;
+    }
+
+    table->entries--;
+
+    // Resize table if necessary
+    if (store->capacity > SWISS_GROUP && table->entries < store->capacity / 8) _swiss_rehash(table, store->capacity / 2);
+
+    return data;
+}
+
+
+// Prefetch first control group of hash then the slot its tag matches
+static void _swiss_prefetch(const hash_t* table, uint32_t hash, int stage)
+{
+    const swiss_t* store = (const swiss_t*) table->store;
+    const uint32_t g = _swiss_h1(hash) & (store->capacity / SWISS_GROUP - 1);
+
+    if (!stage)
+    {
+        __builtin_prefetch(&store->ctrl[g * SWISS_GROUP]);
+        return;
+    }
+
+    const uint32_t match = _swiss_match(&store->ctrl[g * SWISS_GROUP], _swiss_h2(hash));
+    if (match) __builtin_prefetch(&store->slots[g * SWISS_GROUP + __builtin_ctz(match)]);
+}
+
+
+// Print open addressing storage statistics
+static void _swiss_print_stats(const hash_t* table)
+{
+    const swiss_t* store = (const swiss_t*) table->store;
+
+    printf("entries: %zu, size: %zu, alpha %.2f\n", (size_t) table->entries, (size_t) store->capacity, (float) table->entries / store->capacity);
+    printf("groups: %zu, tombstones: %zu, growth-left: %zu\n", (size_t) store->capacity / SWISS_GROUP, (size_t) store->deleted, (size_t) store->growth);
+    printf("approximate overhead in bytes: %zu\n", (size_t) store->capacity * (sizeof(entry_t) + 1) + sizeof(swiss_t) + sizeof(hash_t));
+}
+
+
+// Visualize open addressing storage one group per line
+static void _swiss_print_debug(const hash_t* table)
+{
+    const swiss_t* store = (const swiss_t*) table->store;
+
+    for (uint32_t g = 0; g < store->capacity / SWISS_GROUP; g++)
+    {
+        printf("[%zu] ", (size_t) g);
+        for (uint32_t i = 0; i < SWISS_GROUP; i++)
+        {
+            const uint8_t c = store->ctrl[g * SWISS_GROUP + i];
+            printf("%c", c == SWISS_EMPTY ? '.' : c == SWISS_DELETED ? 'x' : '*');
+        }
+        printf("\n");
+    }
+}
+
+
+const hash_backend_t hash_backend_swiss =
+{
+    "swiss",
+    _swiss_init,
+    _swiss_free,
+    _swiss_insert,
+    _swiss_find_or_insert,
+    _swiss_search,
+    _swiss_remove,
+    _swiss_prefetch,
+    _swiss_print_stats,
+    _swiss_print_debug,
+};
@@ -12,6 +12,16 @@
 #include "hash.h"
 #include "hash-table.h"
 
+typedef struct
+{
+    const char* name;
+    const hash_backend_t* backend;
+    uint32_t rehash_step;
+    uint32_t max_alpha;
+} config_t;
+
+void run(const config_t* config, FILE* dict, double test_duration);
+void table_init(hash_t* table, const config_t* config);
 double wtime(void);
 uint32_t rand32(void);
 uint64_t rand64(void);
@@ -45,8 +55,12 @@ void pairlist_insert(pairlist_t* list, char* key, void* data)
     list->array[list->count++].flag = 0;
 }
 
+// Keys hashed so far (every table hashes a key through keysize)
+static uint64_t hashed;
+
 static inline size_t keysize(const void* key)
 {
+    hashed++;
     return strlen((const char*) key);
 }
 
@@ -55,16 +69,41 @@ static inline int keycmp(const void* a, const void* b)
     return strcmp((const char*) a, (const char*) b);
 }
 
-int main(int argc, char** argv)
+// Map hash to [0, n) by multiply-shift so a second table places keys differently
+static uint32_t hashmap(uint32_t x, uint32_t n)
 {
-    char* tests[] = { "hash_insert", "hash_search", "hash_remove" };
+    return ((uint64_t) x * n) >> 32;
+}
 
-    double test_duration = 5;
+// Merge upserted counts stored as data
+static void* addcount(void* existing, const void* data)
+{
+    return (void*) ((uintptr_t) existing + (uintptr_t) data);
+}
 
-    if (argc > 1)
-    {
-        test_duration = atof(argv[1]);
-    }
+static const config_t configs[] =
+{
+    { "chained", &hash_backend_chained, 0, HASH_MAX_ALPHA },
+    { "incremental", &hash_backend_chained, 4, HASH_MAX_ALPHA },
+    { "inline", &hash_backend_chained, 0, HASH_BUCKET_INLINE },
+    { "swiss", &hash_backend_swiss, 0, 0 },
+    { "robin", &hash_backend_robin, 0, 0 },
+    { "cuckoo", &hash_backend_cuckoo, 0, 0 },
+};
+static const size_t nconfigs = sizeof(configs) / sizeof(configs[0]);
+
+// Initialize an empty table using configuration
+void table_init(hash_t* table, const config_t* config)
+{
+    hash_init_backend(table, config->backend, 10, keysize, keycmp, hash_xxhash, NULL);
+    hash_set_incremental(table, config->rehash_step);
+    if (config->max_alpha) hash_set_max_alpha(table, config->max_alpha);
+}
+
+void run(const config_t* config, FILE* dict, double test_duration)
+{
+    char* tests[] = { "hash_insert", "hash_search", "hash_search_batch", "hash_remove" };
+    enum { BATCH = 1024 };
 
     hash_t table;
 
@@ -73,14 +112,17 @@ int main(int argc, char** argv)
     list.size = 10000;
     list.array = NULL;
 
-    hash_init(&table, 10, keysize, keycmp, hash_xxhash, NULL);
+    table_init(&table, config);
 
-    FILE* dict = fopen("words.txt", "r");
+    rewind(dict);
+    printf("[%s]\n", config->name);
 
-    for (size_t i = 0; i < 3; i++)
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
     {
         double test_start = 0;
         double test_time = 0;
+        double test_worst = 0;
+        double t = 0;
         size_t test_cycles = 0;
 
         do
@@ -103,7 +145,8 @@ int main(int argc, char** argv)
 
                 test_start = wtime();
                 hash_insert(&table, d, d);
-                test_time += wtime() - test_start;
+                t = wtime() - test_start;
+                test_time += t;
             }
             else if (!strcmp(tests[i], "hash_search"))
             {
@@ -113,13 +156,37 @@ int main(int argc, char** argv)
 
                 test_start = wtime();
                 void* hd = hash_search(&table, k);
-                test_time += wtime() - test_start;
+                t = wtime() - test_start;
+                test_time += t;
 
                 if (hd != d)
                 {
                     assert(hd == d);
                 }
             }
+            else if (!strcmp(tests[i], "hash_search_batch"))
+            {
+                const void* keys[BATCH];
+                void* hd[BATCH];
+                uint64_t index[BATCH];
+
+                for (size_t j = 0; j < BATCH; j++)
+                {
+                    index[j] = rand64()%list.count;
+                    keys[j] = list.array[index[j]].key;
+                }
+
+                test_start = wtime();
+                hash_search_batch(&table, keys, BATCH, hd);
+                t = (wtime() - test_start) / BATCH;
+                test_time += t * BATCH;
+                test_cycles += BATCH - 1;
+
+                for (size_t j = 0; j < BATCH; j++)
+                {
+                    assert(hd[j] == list.array[index[j]].data);
+                }
+            }
             else if (!strcmp(tests[i], "hash_remove"))
             {
                 uint64_t index = rand64()%list.count;
@@ -129,7 +196,8 @@ int main(int argc, char** argv)
 
                 test_start = wtime();
                 void* hd = hash_remove(&table, k);
-                test_time += wtime() - test_start;
+                t = wtime() - test_start;
+                test_time += t;
 
                 if (!f)
                 {
@@ -142,17 +210,219 @@ int main(int argc, char** argv)
                 }
             }
 
+            test_worst = t > test_worst ? t : test_worst;
             test_cycles++;
 
         } while (test_time < test_duration);
 
-        printf("%s: %zu iterations over %.2f s -> %.4f ns per operation\n", tests[i], test_cycles, test_time, test_time * 1E9 / test_cycles);
+        printf("%s: %zu iterations over %.2f s -> %.4f ns per operation, %.0f ns worst\n", tests[i], test_cycles, test_time, test_time * 1E9 / test_cycles, test_worst * 1E9);
         hash_print_stats(&table);
         printf("\n");
     }
 
+    // Remaining entries must still be found
+    for (uint64_t i = 0; i < list.count; i++)
+    {
+        void* hd = hash_search(&table, list.array[i].key);
+        assert(hd == (list.array[i].flag ? NULL : list.array[i].data));
+    }
+
+    hash_free(&table, NULL, NULL);
+
+    // Bulk load every inserted key into a fresh table
+    const void** keys = (const void**) malloc(list.count * sizeof(void*));
+    const void** datas = (const void**) malloc(list.count * sizeof(void*));
+    for (uint64_t i = 0; i < list.count; i++)
+    {
+        keys[i] = list.array[i].key;
+        datas[i] = list.array[i].data;
+    }
+
+    table_init(&table, config);
+
+    const double build_start = wtime();
+    hash_build(&table, keys, datas, list.count, 0);
+    const double build_time = wtime() - build_start;
+
+    printf("hash_build: %zu entries over %.2f s -> %.4f ns per entry\n", (size_t) list.count, build_time, build_time * 1E9 / list.count);
+    hash_print_stats(&table);
+    printf("\n");
+
+    for (uint64_t i = 0; i < list.count; i++) assert(hash_search(&table, keys[i]) == datas[i]);
+
     hash_free(&table, NULL, NULL);
 
+    // Build again from every key followed by a copy of each carrying the copy as data
+    const void** dupkeys = (const void**) malloc(2 * list.count * sizeof(void*));
+    const void** dupdatas = (const void**) malloc(2 * list.count * sizeof(void*));
+    for (uint64_t i = 0; i < list.count; i++)
+    {
+        dupkeys[i] = keys[i];
+        dupdatas[i] = datas[i];
+        dupkeys[list.count + i] = strdup(keys[i]);
+        dupdatas[list.count + i] = dupkeys[list.count + i];
+    }
+
+    table_init(&table, config);
+    hash_build(&table, dupkeys, dupdatas, 2 * list.count, 0);
+
+    // Duplicates keep the first key and the last data (blanking the copies shows no table kept one)
+    assert(table.entries == list.count);
+    for (uint64_t i = 0; i < list.count; i++) ((char*) dupkeys[list.count + i])[0] = '\0';
+    for (uint64_t i = 0; i < list.count; i++) assert(hash_search(&table, keys[i]) == dupkeys[list.count + i]);
+
+    hash_free(&table, NULL, NULL);
+
+    for (uint64_t i = 0; i < list.count; i++) free((void*) dupkeys[list.count + i]);
+    free(dupdatas);
+    free(dupkeys);
+
+    // Resizes move stored hashes so growing from a small table hashes every key once
+    table_init(&table, config);
+
+    hashed = 0;
+    for (uint64_t i = 0; i < list.count; i++) hash_insert(&table, keys[i], datas[i]);
+    assert(hashed == list.count);
+
+    hash_free(&table, NULL, NULL);
+
+    // Insert every key again a batch at a time into a fresh table (prefetching takes only the hashes)
+    table_init(&table, config);
+
+    hashed = 0;
+    const double batch_start = wtime();
+    hash_insert_batch(&table, keys, datas, list.count);
+    const double batch_time = wtime() - batch_start;
+    assert(hashed == list.count);
+
+    printf("hash_insert_batch: %zu entries over %.2f s -> %.4f ns per entry\n", (size_t) list.count, batch_time, batch_time * 1E9 / list.count);
+    hash_print_stats(&table);
+    printf("\n");
+
+    assert(table.entries == list.count);
+    for (uint64_t i = 0; i < list.count; i++) assert(hash_search(&table, keys[i]) == datas[i]);
+
+    hash_free(&table, NULL, NULL);
+
+    // Count every key through find-or-insert then upsert starting small so inserts resize the table
+    // Either operation hashes its key once however the insert was placed
+    table_init(&table, config);
+
+    for (uint64_t i = 0; i < list.count; i++)
+    {
+        int inserted = 0;
+        hashed = 0;
+        void** slot = hash_find_or_insert(&table, keys[i], &inserted);
+        assert(inserted && !*slot && hashed == 1);
+
+        // Slot must point into storage left by any resize the insert caused
+        *slot = (void*) 1;
+        assert(hash_search(&table, keys[i]) == (void*) 1);
+    }
+
+    hashed = 0;
+    const double upsert_start = wtime();
+    for (uint64_t i = 0; i < list.count; i++) assert(hash_upsert(&table, keys[i], (void*) 2, addcount) == (void*) 3);
+    const double upsert_time = wtime() - upsert_start;
+    assert(hashed == list.count);
+
+    printf("hash_upsert: %zu entries over %.2f s -> %.4f ns per operation\n", (size_t) list.count, upsert_time, upsert_time * 1E9 / list.count);
+    hash_print_stats(&table);
+    printf("\n");
+
+    for (uint64_t i = 0; i < list.count; i++)
+    {
+        int inserted = 1;
+        void** slot = hash_find_or_insert(&table, keys[i], &inserted);
+        assert(!inserted && *slot == (void*) 3);
+
+        // Without merge new data replaces the old
+        assert(hash_upsert(&table, keys[i], datas[i], NULL) == datas[i]);
+    }
+
+    // Merge is not called for keys that are absent
+    for (uint64_t i = 0; i < list.count; i += 2) assert(hash_remove(&table, keys[i]) == datas[i]);
+    for (uint64_t i = 0; i < list.count; i += 2) assert(hash_upsert(&table, keys[i], datas[i], addcount) == datas[i]);
+
+    assert(table.entries == list.count);
+    for (uint64_t i = 0; i < list.count; i++) assert(hash_search(&table, keys[i]) == datas[i]);
+
+    // Prehashed operations must match plain ones here and on a table of another backend and hashmap
+    // Only hash_key_hash hashes the key, the prehashed operations reuse its hash
+    hash_t other;
+    hash_init_backend(&other, config->backend == &hash_backend_chained ? &hash_backend_swiss : &hash_backend_chained, 10, keysize, keycmp, hash_xxhash, hashmap);
+
+    for (uint64_t i = 0; i < list.count; i++)
+    {
+        hashed = 0;
+        const uint32_t h = hash_key_hash(&table, keys[i]);
+        const void* data = hash_search_h(&table, keys[i], h);
+        hash_insert_h(&other, keys[i], datas[i], h);
+        assert(hashed == 1);
+
+        assert(data == hash_search(&table, keys[i]));
+    }
+
+    assert(other.entries == list.count);
+    for (uint64_t i = 0; i < list.count; i++) assert(hash_search(&other, keys[i]) == datas[i]);
+
+    for (uint64_t i = 0; i < list.count; i += 2)
+    {
+        hashed = 0;
+        const uint32_t h = hash_key_hash(&other, keys[i]);
+
+        assert(hash_remove_h(&table, keys[i], h) == datas[i]);
+        assert(hash_remove_h(&other, keys[i], h) == datas[i]);
+        assert(!hash_search_h(&table, keys[i], h) && !hash_remove_h(&other, keys[i], h));
+        assert(hashed == 1);
+    }
+
+    for (uint64_t i = 0; i < list.count; i++)
+    {
+        assert(hash_search(&table, keys[i]) == (i % 2 ? datas[i] : NULL));
+        assert(hash_search(&other, keys[i]) == (i % 2 ? datas[i] : NULL));
+    }
+
+    hash_free(&other, NULL, NULL);
+    hash_free(&table, NULL, NULL);
+    free(datas);
+    free(keys);
+
+    for (uint64_t i = 0; i < list.count; i++) free(list.array[i].key);
+    free(list.array);
+}
+
+int main(int argc, char** argv)
+{
+    double test_duration = 5;
+
+    if (argc > 1)
+    {
+        test_duration = atof(argv[1]);
+    }
+
+    FILE* dict = fopen("words.txt", "r");
+    if (!dict)
+    {
+        perror("words.txt");
+        return 1;
+    }
+
+    // Run selected configurations (all by default)
+    for (size_t i = 0; i < nconfigs; i++)
+    {
+        int selected = argc <= 2;
+
+        for (int j = 2; j < argc; j++)
+        {
+            if (!strcmp(argv[j], configs[i].name)) selected = 1;
+        }
+
+        if (selected) run(&configs[i], dict, test_duration);
+    }
+
+    fclose(dict);
+
     return 0;
 }
 
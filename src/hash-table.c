@@ -7,6 +7,14 @@
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "hash.h"
 #include "hash-table.h"
@@ -14,6 +22,18 @@
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 
+// Keys hashed and buckets sorted per unit of work claimed by build threads
+#define HASH_BUILD_CHUNK 4096
+
+// Chain tags compared per SIMD instruction
+#if defined(__AVX2__)
+#define HASH_TAG_GROUP 32
+#elif defined(__SSE2__)
+#define HASH_TAG_GROUP 16
+#else
+#define HASH_TAG_GROUP 1
+#endif
+
 
 // Compute the next highest power of 2
 static inline uint32_t _up2(uint32_t x)
@@ -46,6 +66,37 @@ static inline uint32_t _map32(uint32_t x, uint32_t n)
     return ((uint64_t) x * (uint64_t) n) >> 32;
 }
 
+// Compute hash of key (keysize may be omitted for fixed width hashes)
+static inline uint32_t _hash_key(const hash_t* table, const void* key)
+{
+    return table->keyhash(key, table->keysize ? table->keysize(key) : 0);
+}
+
+// Run worker on nthreads threads including the calling thread (0 uses every core)
+static void _parallel(void* (*worker)(void*), void* arg, uint32_t nthreads)
+{
+    nthreads = nthreads ? nthreads : MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+    pthread_t* threads = (pthread_t*) malloc(nthreads * sizeof(pthread_t));
+
+    uint32_t spawned = 1;
+    for (; spawned < nthreads; spawned++)
+    {
+        if (pthread_create(&threads[spawned], NULL, worker, arg)) break;
+    }
+
+    worker(arg);
+
+    for (uint32_t i = 1; i < spawned; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+}
+
+static uint32_t _chained_size(const hash_t* table, uint32_t size);
+static void _chained_alloc(hash_t* table, uint32_t size);
+
 // Iniatialize bucket object
 static void _bucket_init(bucket_t* bucket)
 {
@@ -55,10 +106,162 @@ static void _bucket_init(bucket_t* bucket)
 }
 
 
-// Return index to the position of entry with specified key O(log N)
-static uint32_t _bucket_index_bsearch(const bucket_t* bucket, int (*keycmp)(const void*, const void*), const void* key)
+// Return smallest chain capacity holding count entries
+static inline uint32_t _chain_capacity(uint32_t count)
+{
+    return count <= HASH_CHAIN_MIN ? HASH_CHAIN_MIN : HASH_CHAIN_MIN << (32 - __builtin_clz((count - 1) / HASH_CHAIN_MIN));
+}
+
+// Return size class of chain capacity
+static inline uint32_t _chain_class(uint32_t capacity)
+{
+    return __builtin_ctz(capacity / HASH_CHAIN_MIN);
+}
+
+// Return bytes of chain holding capacity entries followed by their tags (padded for alignment)
+static inline size_t _chain_bytes(uint32_t capacity)
+{
+    return capacity * sizeof(entry_t) + ((capacity + 7) & ~7);
+}
+
+// Return 8-bit fingerprint of hash mixing all bits so bucket maps cannot fix it
+static inline uint8_t _hash_tag(uint32_t hash)
+{
+    return (hash * 0x9E3779B1) >> 24;
+}
+
+
+// Initialize empty chain arena
+static void _arena_init(hash_arena_t* arena)
 {
-    const entry_t* sorted = bucket->chain;
+    memset(arena, 0, sizeof(hash_arena_t));
+    arena->slab_size = HASH_SLAB_SIZE;
+}
+
+
+// Start a new slab holding at least bytes (slabs grow geometrically so a table holds few of them)
+static void _arena_grow(hash_arena_t* arena, size_t bytes)
+{
+    const size_t size = MAX(arena->slab_size, bytes + sizeof(void*));
+    void** slab = (void**) malloc(size);
+
+    *slab = arena->slabs;
+    arena->slabs = slab;
+    arena->cursor = (char*) (slab + 1);
+    arena->remaining = size - sizeof(void*);
+    arena->reserved += size;
+    arena->slab_size = MIN(arena->slab_size * 2, HASH_SLAB_MAX);
+}
+
+
+// Allocate chain of specified capacity from size class free list or current slab
+static entry_t* _arena_alloc(hash_arena_t* arena, uint32_t capacity)
+{
+    const uint32_t c = _chain_class(capacity);
+    const size_t bytes = _chain_bytes(capacity);
+
+    arena->used += bytes;
+
+    // Reuse chain released by this size class
+    void* chain = arena->free[c];
+    if (chain)
+    {
+        arena->free[c] = *(void**) chain;
+        return (entry_t*) chain;
+    }
+
+    if (bytes > arena->remaining) _arena_grow(arena, bytes);
+
+    chain = arena->cursor;
+    arena->cursor += bytes;
+    arena->remaining -= bytes;
+
+    return (entry_t*) chain;
+}
+
+
+// Return chain to its size class free list O(1)
+static void _arena_free(hash_arena_t* arena, entry_t* chain, uint32_t capacity)
+{
+    if (!chain || !capacity) return;
+
+    const uint32_t c = _chain_class(capacity);
+
+    *(void**) chain = arena->free[c];
+    arena->free[c] = chain;
+    arena->used -= _chain_bytes(capacity);
+}
+
+
+// Release every slab at once
+static void _arena_release(hash_arena_t* arena)
+{
+    while (arena->slabs)
+    {
+        void* next = *(void**) arena->slabs;
+        free(arena->slabs);
+        arena->slabs = next;
+    }
+
+    _arena_init(arena);
+}
+
+
+// Return entries of bucket whether inline or spilled to a chain
+static inline entry_t* _bucket_entries(const bucket_t* bucket)
+{
+    return bucket->size ? bucket->chain : (entry_t*) bucket->entries;
+}
+
+// Return number of entries bucket holds without growing
+static inline uint32_t _bucket_capacity(const bucket_t* bucket)
+{
+    return bucket->size ? bucket->size : HASH_BUCKET_INLINE;
+}
+
+// Return tags stored after the entries of a spilled bucket
+static inline uint8_t* _bucket_tags(const bucket_t* bucket)
+{
+    return (uint8_t*) (bucket->chain + bucket->size);
+}
+
+// Recompute tags of spilled bucket from stored hashes
+static void _bucket_retag(bucket_t* bucket)
+{
+    if (!bucket->size) return;
+
+    uint8_t* tags = _bucket_tags(bucket);
+    for (uint32_t j = 0; j < bucket->count; j++) tags[j] = _hash_tag(bucket->chain[j].hash);
+}
+
+
+// Move bucket entries to chain of specified capacity (0 stores them inline)
+static void _bucket_resize(hash_arena_t* arena, bucket_t* bucket, uint32_t capacity)
+{
+    entry_t* old = bucket->size ? bucket->chain : NULL;
+    const uint32_t old_size = bucket->size;
+
+    if (capacity)
+    {
+        entry_t* chain = _arena_alloc(arena, capacity);
+        memcpy(chain, _bucket_entries(bucket), bucket->count * sizeof(entry_t));
+        bucket->chain = chain;
+    }
+    else if (old)
+    {
+        memcpy(bucket->entries, old, bucket->count * sizeof(entry_t));
+    }
+
+    bucket->size = capacity;
+    _arena_free(arena, old, old_size);
+    _bucket_retag(bucket);
+}
+
+
+// Return index to the position of entry with specified key ordered by (hash, key) O(log N)
+static uint32_t _bucket_index_bsearch(const bucket_t* bucket, int (*keycmp)(const void*, const void*), const void* key, uint32_t hash)
+{
+    const entry_t* sorted = _bucket_entries(bucket);
 
     uint32_t l = 0;
     uint32_t u = bucket->count;
@@ -69,8 +272,8 @@ static uint32_t _bucket_index_bsearch(const bucket_t* bucket, int (*keycmp)(cons
         // Update pivot index to be middle of the range
         const uint32_t p = l + ((u - l) >> 1);
 
-        // Compare key to pivot
-        const int comparison = keycmp(key, sorted[p].key);
+        // Compare stored hash first so keys are only touched on a hash match
+        const int comparison = hash != sorted[p].hash ? (hash < sorted[p].hash ? -1 : 1) : keycmp(key, sorted[p].key);
 
         // Use lower half as new range
         if (comparison < 0) u = p;
@@ -84,80 +287,268 @@ static uint32_t _bucket_index_bsearch(const bucket_t* bucket, int (*keycmp)(cons
 }
 
 
-// Return data of entry with specified key O(log N)
-static void* _bucket_bsearch(const bucket_t* bucket, int (*keycmp)(const void*, const void*), const void* key)
+// Return bitmask of tags in group matching tag
+static inline uint32_t _tag_match(const uint8_t* group, uint8_t tag)
 {
-    const void* data = NULL;
+#if defined(__AVX2__)
+    const __m256i tags = _mm256_loadu_si256((const __m256i*) group);
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(tags, _mm256_set1_epi8(tag)));
+#elif defined(__SSE2__)
+    const __m128i tags = _mm_loadu_si128((const __m128i*) group);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(tags, _mm_set1_epi8(tag)));
+#else
+    return *group == tag;
+#endif
+}
+
+
+// Return index of entry with specified key or count if absent comparing keys only on tag matches O(N / HASH_TAG_GROUP)
+static uint32_t _bucket_index_scan(const bucket_t* bucket, int (*keycmp)(const void*, const void*), const void* key, uint32_t hash)
+{
+    const entry_t* chain = _bucket_entries(bucket);
+    uint32_t j = 0;
+
+    // Chains of at least a group hold whole groups of tags, so loads stay within the chain
+    if (bucket->size >= HASH_TAG_GROUP)
+    {
+        const uint8_t* tags = _bucket_tags(bucket);
+        const uint8_t tag = _hash_tag(hash);
+
+        for (; j < bucket->count; j += HASH_TAG_GROUP)
+        {
+            uint32_t match = _tag_match(&tags[j], tag);
+
+            // Ignore stale tags past the last entry
+            const uint32_t left = bucket->count - j;
+            if (left < HASH_TAG_GROUP) match &= (1u << left) - 1;
+
+            for (; match; match &= match - 1)
+            {
+                const uint32_t index = j + __builtin_ctz(match);
 
-    // Find matching entry O(log N)
-    const uint32_t index = _bucket_index_bsearch(bucket, keycmp, key);
-    const entry_t* chain = bucket->chain;
+                if (chain[index].hash == hash && !keycmp(key, chain[index].key)) return index;
+            }
+        }
+
+        return bucket->count;
+    }
 
-    // Return matching entry
-    if (index < bucket->count && !keycmp(key, chain[index].key))
+    // Short chains and inline entries compare stored hashes directly
+    for (; j < bucket->count; j++)
     {
-        data = chain[index].data;
+        if (chain[j].hash == hash && !keycmp(key, chain[j].key)) return j;
     }
 
-    return (void*) data;
+    return bucket->count;
 }
 
-// Insert new entry into bucket in sorted order O(N)
-static void _bucket_binsert(bucket_t* bucket, int (*keycmp)(const void*, const void*), const void* key, const void* data)
+
+// Return data of entry with specified key O(N / HASH_TAG_GROUP)
+static void* _bucket_search(const bucket_t* bucket, int (*keycmp)(const void*, const void*), const void* key, uint32_t hash)
 {
-    // Expand bucket memory if necessary
-    if (bucket->count == bucket->size)
-    {
-        bucket->size += HASH_BLOCK_SIZE;
-        bucket->chain = (entry_t*) realloc(bucket->chain, bucket->size * sizeof(entry_t));
-    }
+    const uint32_t index = _bucket_index_scan(bucket, keycmp, key, hash);
 
+    return index < bucket->count ? (void*) _bucket_entries(bucket)[index].data : NULL;
+}
+
+// Return entry with specified key inserting it in sorted order with NULL data if absent O(N)
+static entry_t* _bucket_binsert(hash_arena_t* arena, bucket_t* bucket, int (*keycmp)(const void*, const void*), const void* key, uint32_t hash, int* inserted)
+{
     // Determine position to insert at O(log N)
-    const uint32_t index = _bucket_index_bsearch(bucket, keycmp, key);
-    entry_t* chain = bucket->chain;
+    const uint32_t index = _bucket_index_bsearch(bucket, keycmp, key, hash);
+    entry_t* chain = _bucket_entries(bucket);
+
+    // Return existing entry (duplicates not allowed!)
+    *inserted = !(index < bucket->count && chain[index].hash == hash && !keycmp(key, chain[index].key));
+    if (!*inserted) return &chain[index];
 
-    // Update existing entry (duplicates not allowed!)
-    if (index < bucket->count && !keycmp(key, chain[index].key))
+    // Expand bucket memory if necessary (spilling inline entries to a chain)
+    if (bucket->count == _bucket_capacity(bucket))
     {
-        chain[index].data = data;
+        _bucket_resize(arena, bucket, _chain_capacity(bucket->count + 1));
+        chain = bucket->chain;
     }
-    // Insert and shift entries into place O(N)
-    else if (index <= bucket->count)
+
+    // Insert and shift entries and their tags into place O(N)
+    if (bucket->size)
     {
-        memmove(&chain[index + 1], &chain[index], (bucket->count++ - index) * sizeof(entry_t));
-        chain[index].key = key;
-        chain[index].data = data;
+        uint8_t* tags = _bucket_tags(bucket);
+        memmove(&tags[index + 1], &tags[index], bucket->count - index);
+        tags[index] = _hash_tag(hash);
     }
+
+    memmove(&chain[index + 1], &chain[index], (bucket->count++ - index) * sizeof(entry_t));
+    chain[index].key = key;
+    chain[index].data = NULL;
+    chain[index].hash = hash;
+
+    return &chain[index];
 }
 
-static void* _bucket_bremove(bucket_t* bucket, int (*keycmp)(const void*, const void*), const void* key)
+// Remove entry with specified key from bucket returning data O(N)
+static void* _bucket_remove(hash_arena_t* arena, bucket_t* bucket, int (*keycmp)(const void*, const void*), const void* key, uint32_t hash)
 {
-    const void* data = NULL;
+    const uint32_t index = _bucket_index_scan(bucket, keycmp, key, hash);
+    if (index == bucket->count) return NULL;
 
-    // Find matching entry O(log N)
-    const uint32_t index = _bucket_index_bsearch(bucket, keycmp, key);
-    entry_t* chain = bucket->chain;
+    entry_t* chain = _bucket_entries(bucket);
+    const void* data = chain[index].data;
 
-    // Shift entries into place O(N)
-    if (index < bucket->count && !keycmp(key, chain[index].key))
+    // Shift entries and their tags into place O(N)
+    if (bucket->size)
     {
-        data = chain[index].data;
-        memmove(&chain[index], &chain[index + 1], (--bucket->count - index) * sizeof(entry_t));
+        uint8_t* tags = _bucket_tags(bucket);
+        memmove(&tags[index], &tags[index + 1], bucket->count - index - 1);
     }
 
+    memmove(&chain[index], &chain[index + 1], (--bucket->count - index) * sizeof(entry_t));
+
+    // Move remaining entries back inline
+    if (bucket->size && bucket->count <= HASH_BUCKET_INLINE) _bucket_resize(arena, bucket, 0);
+
     return (void*) data;
 }
 
 
-// Create new larger hash table
-static void _hash_rehash(hash_t* table, uint32_t size)
+// Compare entries by (hash, key)
+static inline int _entry_cmp(const entry_t* a, const entry_t* b, int (*keycmp)(const void*, const void*))
 {
-    if (!table || size == table->size) return;
+    if (a->hash != b->hash) return a->hash < b->hash ? -1 : 1;
+
+    return keycmp(a->key, b->key);
+}
+
+
+// Sort chain by (hash, key) using scratch space for half the chain O(N log N)
+static void _chain_sort(entry_t* chain, entry_t* scratch, uint32_t n, int (*keycmp)(const void*, const void*))
+{
+    if (n < 2) return;
+
+    const uint32_t h = n / 2;
+    _chain_sort(chain, scratch, h, keycmp);
+    _chain_sort(chain + h, scratch, n - h, keycmp);
+
+    // Skip merge when halves are already in order
+    if (_entry_cmp(&chain[h - 1], &chain[h], keycmp) <= 0) return;
+
+    memcpy(scratch, chain, h * sizeof(entry_t));
+
+    uint32_t i = 0, j = h, k = 0;
+    while (i < h && j < n) chain[k++] = _entry_cmp(&chain[j], &scratch[i], keycmp) < 0 ? chain[j++] : scratch[i++];
+    while (i < h) chain[k++] = scratch[i++];
+}
+
+
+// Split every bucket i between i and i + size in place keeping chain order O(N)
+static void _chained_split(hash_t* table)
+{
+    const uint32_t size = table->size;
+
+    // Buckets keep cache line alignment so they cannot be grown with realloc
+    bucket_t* buckets = (bucket_t*) aligned_alloc(sizeof(bucket_t), size * 2 * sizeof(bucket_t));
+    memcpy(buckets, table->buckets, size * sizeof(bucket_t));
+    free(table->buckets);
+
+    table->size = size * 2;
+    table->buckets = buckets;
+
+    // Moving entries are staged in a reused scratch buffer so chains are allocated exactly
+    entry_t* scratch = NULL;
+    uint32_t scratch_size = 0;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        bucket_t* lower = &table->buckets[i];
+        bucket_t* upper = &table->buckets[i + size];
+        const uint32_t n = lower->count;
+
+        _bucket_init(upper);
+        if (!n) continue;
+
+        if (n > scratch_size)
+        {
+            scratch_size = _chain_capacity(n);
+            scratch = (entry_t*) realloc(scratch, scratch_size * sizeof(entry_t));
+        }
+
+        // Stable partition keeps both halves sorted
+        entry_t* chain = _bucket_entries(lower);
+        uint32_t k = 0, m = 0;
+        for (uint32_t j = 0; j < n; j++)
+        {
+            const entry_t* entry = &chain[j];
+
+            if (table->hashmap(entry->hash, table->size) == i) chain[k++] = *entry;
+            else scratch[m++] = *entry;
+        }
+
+        lower->count = k;
+
+        // Only the moving half needs new memory
+        if (m > HASH_BUCKET_INLINE) _bucket_resize(&table->arena, upper, _chain_capacity(m));
+        memcpy(_bucket_entries(upper), scratch, m * sizeof(entry_t));
+        upper->count = m;
+
+        // Return lower chain memory when it fits inline or shrank by more than one size class
+        if (lower->size && k <= HASH_BUCKET_INLINE) _bucket_resize(&table->arena, lower, 0);
+        else if (_chain_capacity(k) < lower->size / 2) _bucket_resize(&table->arena, lower, _chain_capacity(k));
+        else _bucket_retag(lower);
+
+        _bucket_retag(upper);
+    }
+
+    free(scratch);
+}
+
+
+// Create new resized hash table counting entries per bucket before moving them
+static void _chained_rehash(hash_t* table, uint32_t size)
+{
+    if (!table) return;
+
+    size = _chained_size(table, size);
+    if (size == table->size) return;
+
+    // Doubling with _map2 or _mod sends bucket i only to i or i + size
+    if (size == table->size * 2 && (table->hashmap == _map2 || table->hashmap == _mod))
+    {
+        _chained_split(table);
+        return;
+    }
 
     bucket_t* old_buckets = table->buckets;
-    uint32_t old_size = table->size;
+    const uint32_t old_size = table->size;
 
-    hash_init(table, size, table->keysize, table->keycmp, table->keyhash, table->hashmap);
+    // Count entries destined for each bucket using stored hashes
+    uint32_t* counts = (uint32_t*) calloc(size, sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < old_size; i++)
+    {
+        const bucket_t* bucket = &old_buckets[i];
+
+        for (uint32_t j = 0; j < bucket->count; j++)
+        {
+            counts[table->hashmap(_bucket_entries(bucket)[j].hash, size)]++;
+        }
+    }
+
+    _chained_alloc(table, size);
+
+    // Allocate every chain exactly once
+    uint32_t longest = 0;
+    for (uint32_t i = 0; i < table->size; i++)
+    {
+        bucket_t* bucket = &table->buckets[i];
+
+        longest = MAX(counts[i], longest);
+        if (counts[i] > HASH_BUCKET_INLINE) _bucket_resize(&table->arena, bucket, _chain_capacity(counts[i]));
+    }
+
+    free(counts);
+
+    // Scatter entries in source order noting chains that receive them out of order
+    uint8_t* unsorted = (uint8_t*) calloc(table->size, sizeof(uint8_t));
+    uint32_t merges = 0;
 
     for (uint32_t i = 0; i < old_size; i++)
     {
@@ -165,33 +556,171 @@ static void _hash_rehash(hash_t* table, uint32_t size)
 
         for (uint32_t j = 0; j < bucket->count; j++)
         {
-            const entry_t* entry = &bucket->chain[j];
+            const entry_t* entry = &_bucket_entries(bucket)[j];
+            const uint32_t index = table->hashmap(entry->hash, table->size);
+            bucket_t* dest = &table->buckets[index];
+            entry_t* chain = _bucket_entries(dest);
+
+            if (dest->count && !unsorted[index] && _entry_cmp(&chain[dest->count - 1], entry, table->keycmp) > 0)
+            {
+                unsorted[index] = 1;
+                merges++;
+            }
 
-            hash_insert(table, entry->key, entry->data);
+            chain[dest->count++] = *entry;
         }
 
-        free(bucket->chain);
+        _arena_free(&table->arena, bucket->chain, bucket->size);
     }
 
     free(old_buckets);
+
+    // Monotone maps (_map32) keep every chain sorted, other maps interleave sorted runs
+    entry_t* scratch = merges ? (entry_t*) malloc(longest / 2 * sizeof(entry_t)) : NULL;
+
+    for (uint32_t i = 0; i < table->size; i++)
+    {
+        bucket_t* bucket = &table->buckets[i];
+
+        if (unsorted[i]) _chain_sort(_bucket_entries(bucket), scratch, bucket->count, table->keycmp);
+        _bucket_retag(bucket);
+    }
+
+    free(scratch);
+    free(unsorted);
 }
 
 
-// Initialize a hash table object
-void hash_init(hash_t* table, uint32_t size, size_t (*keysize)(const void*), int (*keycmp)(const void*, const void*), uint32_t (*keyhash)(const void*, size_t), uint32_t (*hashmap)(uint32_t, uint32_t))
+// Object representing buckets sorted by build threads
+typedef struct
 {
-    if (!table) return;
+    hash_t* table;
+    uint32_t longest;
+    size_t next;
+    uint64_t removed;
+} _chained_build_t;
+
+// Sort claimed ranges of buckets by (hash, key) keeping the first key and last data of duplicates
+static void* _chained_build_worker(void* arg)
+{
+    _chained_build_t* build = (_chained_build_t*) arg;
+    hash_t* table = build->table;
 
-    // Initialize table functions
-    table->keysize = keysize;
-    table->keycmp = keycmp;
-    table->keyhash = keyhash ? keyhash : hash_fnv1a;
-    table->hashmap = hashmap ? hashmap : _mod;
+    entry_t* scratch = (entry_t*) malloc(MAX(build->longest / 2, 1) * sizeof(entry_t));
+    uint64_t removed = 0;
+
+    size_t first;
+    while ((first = __atomic_fetch_add(&build->next, HASH_BUILD_CHUNK, __ATOMIC_RELAXED)) < table->size)
+    {
+        for (size_t i = first; i < MIN(first + HASH_BUILD_CHUNK, table->size); i++)
+        {
+            bucket_t* bucket = &table->buckets[i];
+            entry_t* chain = _bucket_entries(bucket);
+
+            // Merge sort is stable so equal keys stay in input order
+            _chain_sort(chain, scratch, bucket->count, table->keycmp);
+
+            uint32_t k = 0;
+            for (uint32_t j = 0; j < bucket->count; j++)
+            {
+                // Repeated hash_insert keeps the stored key and replaces only its data
+                if (k && !_entry_cmp(&chain[k - 1], &chain[j], table->keycmp)) chain[k - 1].data = chain[j].data;
+                else chain[k++] = chain[j];
+            }
+
+            removed += bucket->count - k;
+            bucket->count = k;
+            _bucket_retag(bucket);
+        }
+    }
+
+    free(scratch);
+    __atomic_add_fetch(&build->removed, removed, __ATOMIC_RELAXED);
+
+    return NULL;
+}
+
+
+// Replace empty chained storage with n entries sized, placed and sorted once O(N)
+static void _chained_build(hash_t* table, const void* const* keys, const void* const* data, const uint32_t* hashes, size_t n, uint32_t nthreads)
+{
+    // Size for half the maximum depth so later inserts do not grow it at once
+    free(table->old_buckets);
+    table->old_buckets = NULL;
+    table->old_size = 0;
+    table->migrated = 0;
+
+    free(table->buckets);
+    _chained_alloc(table, MAX(MIN(n * 2 / table->max_alpha, UINT32_MAX), table->size));
+
+    // Count entries per bucket using buckets as counters
+    for (size_t i = 0; i < n; i++) table->buckets[table->hashmap(hashes[i], table->size)].count++;
+
+    // Every chain is carved from a single slab
+    size_t bytes = 0;
+    uint32_t longest = 0;
+    for (uint32_t i = 0; i < table->size; i++)
+    {
+        const uint32_t count = table->buckets[i].count;
+
+        longest = MAX(count, longest);
+        if (count > HASH_BUCKET_INLINE) bytes += _chain_bytes(_chain_capacity(count));
+    }
+
+    if (bytes > table->arena.remaining) _arena_grow(&table->arena, bytes);
+
+    for (uint32_t i = 0; i < table->size; i++)
+    {
+        bucket_t* bucket = &table->buckets[i];
+        const uint32_t count = bucket->count;
+
+        bucket->count = 0;
+        if (count > HASH_BUCKET_INLINE) _bucket_resize(&table->arena, bucket, _chain_capacity(count));
+    }
 
+    // Scatter entries in input order
+    for (size_t i = 0; i < n; i++)
+    {
+        bucket_t* bucket = &table->buckets[table->hashmap(hashes[i], table->size)];
+        entry_t* entry = &_bucket_entries(bucket)[bucket->count++];
+
+        entry->key = keys[i];
+        entry->data = data[i];
+        entry->hash = hashes[i];
+    }
+
+    _chained_build_t build;
+    build.table = table;
+    build.longest = longest;
+    build.next = 0;
+    build.removed = 0;
+
+    _parallel(_chained_build_worker, &build, nthreads);
+
+    table->entries = n - build.removed;
+
+    // Duplicate keys may leave chains short enough to move back inline
+    for (uint32_t i = 0; build.removed && i < table->size; i++)
+    {
+        bucket_t* bucket = &table->buckets[i];
+        if (bucket->size && bucket->count <= HASH_BUCKET_INLINE) _bucket_resize(&table->arena, bucket, 0);
+    }
+}
+
+
+// Return bucket count used for requested size
+static inline uint32_t _chained_size(const hash_t* table, uint32_t size)
+{
+    return table->hashmap == _map2 ? _up2(size) : MAX(size, 1);
+}
+
+
+// Allocate empty bucket array leaving entry count untouched
+static void _chained_alloc(hash_t* table, uint32_t size)
+{
     // Initialize size and allocate buckets
-    table->entries = 0;
-    table->size = table->hashmap == _map2 ? _up2(size) : size;
-    table->buckets = (bucket_t*) malloc(table->size * sizeof(bucket_t));
+    table->size = _chained_size(table, size);
+    table->buckets = (bucket_t*) aligned_alloc(sizeof(bucket_t), table->size * sizeof(bucket_t));
 
     // Initialize buckets
     for (uint32_t i = 0; i < table->size; i++)
@@ -201,93 +730,193 @@ void hash_init(hash_t* table, uint32_t size, size_t (*keysize)(const void*), int
 }
 
 
-// Cleanup and deallocate a hash table object
-void hash_free(hash_t* table, void (*keyfree)(const void*), void(*datafree)(const void*))
+// Initialize chained storage
+static void _chained_init(hash_t* table, uint32_t size)
 {
-    if (!table) return;
+    table->entries = 0;
+    table->old_buckets = NULL;
+    table->old_size = 0;
+    table->migrated = 0;
 
-    for (uint32_t i = 0; i < table->size; i++)
+    _arena_init(&table->arena);
+    _chained_alloc(table, size);
+}
+
+
+// Move entries of an old bucket into the current bucket array
+static void _chained_migrate_bucket(hash_t* table, uint32_t i)
+{
+    bucket_t* bucket = &table->old_buckets[i];
+
+    for (uint32_t j = 0; j < bucket->count; j++)
     {
-        bucket_t* bucket = &table->buckets[i];
+        const entry_t* entry = &_bucket_entries(bucket)[j];
+        const uint32_t index = table->hashmap(entry->hash, table->size);
+
+        int inserted;
+        _bucket_binsert(&table->arena, &table->buckets[index], table->keycmp, entry->key, entry->hash, &inserted)->data = entry->data;
+    }
+
+    _arena_free(&table->arena, bucket->chain, bucket->size);
+    _bucket_init(bucket);
+}
+
+
+// Migrate old buckets in order finishing the resize once all are moved
+static void _chained_migrate(hash_t* table, uint32_t n)
+{
+    while (n-- && table->migrated < table->old_size) _chained_migrate_bucket(table, table->migrated++);
+
+    if (table->migrated == table->old_size)
+    {
+        free(table->old_buckets);
+        table->old_buckets = NULL;
+        table->old_size = 0;
+        table->migrated = 0;
+    }
+}
+
+
+// Make the bucket of hash current and advance an incremental resize
+static void _chained_settle(hash_t* table, uint32_t hash)
+{
+    if (!table->old_buckets) return;
+
+    // Key must live in the current array before it is modified
+    const uint32_t old = table->hashmap(hash, table->old_size);
+    if (old >= table->migrated) _chained_migrate_bucket(table, old);
+
+    _chained_migrate(table, table->rehash_step ? table->rehash_step : table->old_size);
+}
 
-        // Free key and data if free functions are provided
-        if (keyfree || datafree)
+
+// Resize at once or begin an incremental resize
+static void _chained_resize(hash_t* table, uint32_t size)
+{
+    if (!table->rehash_step)
+    {
+        _chained_rehash(table, size);
+        return;
+    }
+
+    if (size == table->size) return;
+
+    // Old and new bucket arrays coexist until migration completes
+    table->old_buckets = table->buckets;
+    table->old_size = table->size;
+    table->migrated = 0;
+
+    _chained_alloc(table, size);
+}
+
+
+// Cleanup and deallocate chained storage
+static void _chained_free(hash_t* table, void (*keyfree)(const void*), void(*datafree)(const void*))
+{
+    // Free key and data if free functions are provided
+    if (keyfree || datafree)
+    {
+        // Finish pending migration so every entry is in one array
+        if (table->old_buckets) _chained_migrate(table, table->old_size);
+
+        for (uint32_t i = 0; i < table->size; i++)
         {
+            const bucket_t* bucket = &table->buckets[i];
+
             for (uint32_t j = 0; j < bucket->count; j++)
             {
-                const entry_t* entry = &bucket->chain[j];
+                const entry_t* entry = &_bucket_entries(bucket)[j];
 
                 if (keyfree) keyfree(entry->key);
                 if (datafree) datafree(entry->data);
             }
         }
-
-        free(bucket->chain);
     }
 
+    // Chains live in the arena so they are released with its slabs
+    _arena_release(&table->arena);
+    free(table->old_buckets);
     free(table->buckets);
 }
 
 
-// Insert new entry into hash table using specified key O(1)
-void hash_insert(hash_t* table, const void* key, const void* data)
+// Return data slot of entry with specified key inserting it with NULL data if absent O(1)
+static const void** _chained_find_or_insert(hash_t* table, const void* key, uint32_t hash, int* inserted)
 {
-    if (!table) return;
-
     // Resize table if necessary
-    if (table->entries / table->size >= HASH_MAX_ALPHA) _hash_rehash(table, MAX(table->size * HASH_GROWTH_FACTOR, 8));
+    if (!table->old_buckets && table->entries >= (uint64_t) table->size * table->max_alpha) _chained_resize(table, MAX(table->size * HASH_GROWTH_FACTOR, 8));
+    _chained_settle(table, hash);
 
     // Determine which bucket to process
-    const uint32_t hash = table->keyhash(key, table->keysize(key));
     const uint32_t index = table->hashmap(hash, table->size);
 
-    // Insert into bucket
-    _bucket_binsert(&table->buckets[index], table->keycmp, key, data);
-    table->entries++;
+    // Find or insert into bucket
+    entry_t* entry = _bucket_binsert(&table->arena, &table->buckets[index], table->keycmp, key, hash, inserted);
+    table->entries += *inserted;
+
+    return &entry->data;
+}
+
+
+// Insert new entry into chained storage O(1)
+static void _chained_insert(hash_t* table, const void* key, const void* data, uint32_t hash)
+{
+    int inserted;
+    *_chained_find_or_insert(table, key, hash, &inserted) = data;
 }
 
 
 // Return data of the entry with specified key O(1)
-void* hash_search(const hash_t* table, const void* key)
+static void* _chained_search(const hash_t* table, const void* key, uint32_t hash)
 {
-    if (!table || !table->entries) return NULL;
+    // Unmigrated entries are still found in the old bucket array
+    if (table->old_buckets)
+    {
+        const uint32_t old = table->hashmap(hash, table->old_size);
+        void* data = _bucket_search(&table->old_buckets[old], table->keycmp, key, hash);
+        if (data) return data;
+    }
 
     // Determine which bucket to process
-    const uint32_t hash = table->keyhash(key, table->keysize(key));
     const uint32_t index = table->hashmap(hash, table->size);
 
     // Search bucket for key
-    void* data = _bucket_bsearch(&table->buckets[index], table->keycmp, key);
-
-    return data;
+    return _bucket_search(&table->buckets[index], table->keycmp, key, hash);
 }
 
 
 // Remove entry with specified key returning data O(1)
-void* hash_remove(hash_t* table, const void* key)
+static void* _chained_remove(hash_t* table, const void* key, uint32_t hash)
 {
-    if (!table || !table->entries) return NULL;
+    _chained_settle(table, hash);
 
     // Determine which bucket to process
-    const uint32_t hash = table->keyhash(key, table->keysize(key));
     const uint32_t index = table->hashmap(hash, table->size);
 
     // Remove entry from bucket
-    void* data = _bucket_bremove(&table->buckets[index], table->keycmp, key);
+    void* data = _bucket_remove(&table->arena, &table->buckets[index], table->keycmp, key, hash);
     if (data) table->entries--;
 
     // Resize table if necessary
-    if (table->entries / table->size < HASH_MAX_ALPHA / 4) _hash_rehash(table, MAX(table->size / 2, 8));
+    if (!table->old_buckets && table->entries * 4 < (uint64_t) table->size * table->max_alpha) _chained_resize(table, MAX(table->size / 2, 8));
 
     return data;
 }
 
 
-// Print table statistics
-void hash_print_stats(const hash_t* table)
+// Prefetch bucket of hash then its chain tags once the bucket has arrived
+static void _chained_prefetch(const hash_t* table, uint32_t hash, int stage)
 {
-    if (!table) return;
+    const bucket_t* bucket = &table->buckets[table->hashmap(hash, table->size)];
 
+    if (!stage) __builtin_prefetch(bucket);
+    else if (bucket->size) __builtin_prefetch(_bucket_tags(bucket));
+}
+
+
+// Print chained storage statistics
+static void _chained_print_stats(const hash_t* table)
+{
     uint32_t max = 0;
     uint32_t min = UINT32_MAX;
     uint32_t avg = 0;
@@ -303,15 +932,18 @@ void hash_print_stats(const hash_t* table)
 
     printf("entries: %zu, size: %zu, alpha %.2f\n", (size_t) table->entries, (size_t) table->size, (float) table->entries / table->size);
     printf("min-depth: %zu, avg-depth: %.0f, max-depth: %zu\n", (size_t) min, (float) avg / table->size, (size_t) max);
-    printf("approximate overhead in bytes: %zu\n", (size_t) avg * sizeof(entry_t) + table->size * sizeof(bucket_t) + sizeof(hash_t));
+    // Actual memory held by the table including unused chain capacity and free lists
+    const size_t carved = table->arena.reserved - table->arena.remaining;
+    const size_t bytes = carved + (size_t) (table->size + table->old_size) * sizeof(bucket_t) + sizeof(hash_t);
+    printf("chain bytes: %zu used, %zu free listed, %zu reserved\n", (size_t) table->arena.used, carved - (size_t) table->arena.used, (size_t) table->arena.reserved);
+    printf("memory in bytes: %zu, %.1f per entry\n", bytes, table->entries ? (float) bytes / table->entries : 0.0f);
+    if (table->old_buckets) printf("migrating: %zu of %zu old buckets moved\n", (size_t) table->migrated, (size_t) table->old_size);
 }
 
 
-// Debug print used to visualize hash table
-void hash_print_debug(const hash_t* table)
+// Visualize chained storage
+static void _chained_print_debug(const hash_t* table)
 {
-    if (!table) return;
-
     for (uint32_t i = 0; i < table->size; i++)
     {
         const bucket_t* bucket = &table->buckets[i];
@@ -321,3 +953,322 @@ void hash_print_debug(const hash_t* table)
         printf("\n");
     }
 }
+
+
+const hash_backend_t hash_backend_chained =
+{
+    "chained",
+    _chained_init,
+    _chained_free,
+    _chained_insert,
+    _chained_find_or_insert,
+    _chained_search,
+    _chained_remove,
+    _chained_prefetch,
+    _chained_print_stats,
+    _chained_print_debug,
+};
+
+
+// Initialize a hash table object
+void hash_init(hash_t* table, uint32_t size, size_t (*keysize)(const void*), int (*keycmp)(const void*, const void*), uint32_t (*keyhash)(const void*, size_t), uint32_t (*hashmap)(uint32_t, uint32_t))
+{
+    hash_init_backend(table, &hash_backend_chained, size, keysize, keycmp, keyhash, hashmap);
+}
+
+
+// Initialize a hash table object using specified storage engine
+void hash_init_backend(hash_t* table, const hash_backend_t* backend, uint32_t size, size_t (*keysize)(const void*), int (*keycmp)(const void*, const void*), uint32_t (*keyhash)(const void*, size_t), uint32_t (*hashmap)(uint32_t, uint32_t))
+{
+    if (!table) return;
+
+    // Initialize table functions
+    table->keysize = keysize;
+    table->keycmp = keycmp;
+    table->keyhash = keyhash ? keyhash : hash_fnv1a;
+    table->hashmap = hashmap ? hashmap : _mod;
+
+    // Initialize storage
+    table->buckets = NULL;
+    table->old_buckets = NULL;
+    table->rehash_step = 0;
+    table->max_alpha = HASH_MAX_ALPHA;
+    table->store = NULL;
+    table->backend = backend ? backend : &hash_backend_chained;
+    table->backend->init(table, size);
+}
+
+
+// Spread chained table resizes over later operations migrating step buckets each
+void hash_set_incremental(hash_t* table, uint32_t step)
+{
+    if (!table) return;
+
+    table->rehash_step = step;
+}
+
+
+// Set average chained bucket depth that triggers growth
+void hash_set_max_alpha(hash_t* table, uint32_t alpha)
+{
+    if (!table) return;
+
+    table->max_alpha = MAX(alpha, 1);
+}
+
+
+// Cleanup and deallocate a hash table object
+void hash_free(hash_t* table, void (*keyfree)(const void*), void(*datafree)(const void*))
+{
+    if (!table) return;
+
+    table->backend->free(table, keyfree, datafree);
+}
+
+
+// Insert new entry into hash table using specified key O(1)
+void hash_insert(hash_t* table, const void* key, const void* data)
+{
+    if (!table) return;
+
+    table->backend->insert(table, key, data, _hash_key(table, key));
+}
+
+
+// Return data of the entry with specified key O(1)
+void* hash_search(const hash_t* table, const void* key)
+{
+    if (!table || !table->entries) return NULL;
+
+    return table->backend->search(table, key, _hash_key(table, key));
+}
+
+
+// Return pointer to data of the entry with specified key inserting it with NULL data if absent O(1)
+void** hash_find_or_insert(hash_t* table, const void* key, int* inserted)
+{
+    if (!table) return NULL;
+
+    int created;
+    const void** slot = table->backend->find_or_insert(table, key, _hash_key(table, key), &created);
+    if (inserted) *inserted = created;
+
+    return (void**) slot;
+}
+
+
+// Insert data or replace existing data with merge(existing, data) returning stored data O(1)
+void* hash_upsert(hash_t* table, const void* key, const void* data, void* (*merge)(void*, const void*))
+{
+    if (!table) return NULL;
+
+    // Key is hashed and its bucket probed once for both cases
+    int inserted;
+    const void** slot = table->backend->find_or_insert(table, key, _hash_key(table, key), &inserted);
+    *slot = inserted || !merge ? data : merge((void*) *slot, data);
+
+    return (void*) *slot;
+}
+
+
+// Remove entry with specified key returning data O(1)
+void* hash_remove(hash_t* table, const void* key)
+{
+    if (!table || !table->entries) return NULL;
+
+    return table->backend->remove(table, key, _hash_key(table, key));
+}
+
+
+// Return hash of key as computed by table for use with the prehashed operations
+uint32_t hash_key_hash(const hash_t* table, const void* key)
+{
+    if (!table) return 0;
+
+    return _hash_key(table, key);
+}
+
+
+// Insert new entry using hash previously returned by hash_key_hash O(1)
+void hash_insert_h(hash_t* table, const void* key, const void* data, uint32_t hash)
+{
+    if (!table) return;
+
+    table->backend->insert(table, key, data, hash);
+}
+
+
+// Return data of the entry with specified key using hash previously returned by hash_key_hash O(1)
+void* hash_search_h(const hash_t* table, const void* key, uint32_t hash)
+{
+    if (!table || !table->entries) return NULL;
+
+    return table->backend->search(table, key, hash);
+}
+
+
+// Remove entry with specified key using hash previously returned by hash_key_hash returning data O(1)
+void* hash_remove_h(hash_t* table, const void* key, uint32_t hash)
+{
+    if (!table || !table->entries) return NULL;
+
+    return table->backend->remove(table, key, hash);
+}
+
+
+// Compute hashes of keys using a SIMD batch hash when table uses one
+static void _hash_keys(const hash_t* table, const void* const* keys, uint32_t* hashes, size_t n)
+{
+    if (table->keysize && (table->keyhash == hash_xxhash || table->keyhash == hash_murmur3))
+    {
+        size_t lengths[HASH_BATCH_SIZE];
+        for (size_t i = 0; i < n; i++) lengths[i] = table->keysize(keys[i]);
+
+        if (table->keyhash == hash_xxhash) hash_xxhash_batch(keys, lengths, hashes, n);
+        else hash_murmur3_batch(keys, lengths, hashes, n);
+
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++) hashes[i] = _hash_key(table, keys[i]);
+}
+
+
+// Hash a batch of keys and prefetch their buckets so the misses overlap
+static void _hash_prefetch(const hash_t* table, const void* const* keys, uint32_t* hashes, size_t n)
+{
+    _hash_keys(table, keys, hashes, n);
+
+    // Memory found in a bucket is prefetched only after every bucket was requested
+    for (size_t i = 0; i < n; i++) table->backend->prefetch(table, hashes[i], 0);
+    for (size_t i = 0; i < n; i++) table->backend->prefetch(table, hashes[i], 1);
+}
+
+
+// Insert n entries prefetching their buckets a batch at a time
+void hash_insert_batch(hash_t* table, const void* const* keys, const void* const* data, size_t n)
+{
+    if (!table) return;
+
+    uint32_t hashes[HASH_BATCH_SIZE];
+
+    for (size_t i = 0; i < n; i += HASH_BATCH_SIZE)
+    {
+        const size_t m = MIN(n - i, HASH_BATCH_SIZE);
+
+        _hash_prefetch(table, &keys[i], hashes, m);
+        for (size_t j = 0; j < m; j++) table->backend->insert(table, keys[i + j], data[i + j], hashes[j]);
+    }
+}
+
+
+// Store data of each of n keys (NULL if absent) in out prefetching their buckets a batch at a time
+void hash_search_batch(const hash_t* table, const void* const* keys, size_t n, void** out)
+{
+    if (!table) return;
+
+    if (!table->entries)
+    {
+        memset(out, 0, n * sizeof(void*));
+        return;
+    }
+
+    uint32_t hashes[HASH_BATCH_SIZE];
+
+    for (size_t i = 0; i < n; i += HASH_BATCH_SIZE)
+    {
+        const size_t m = MIN(n - i, HASH_BATCH_SIZE);
+
+        _hash_prefetch(table, &keys[i], hashes, m);
+        for (size_t j = 0; j < m; j++) out[i + j] = table->backend->search(table, keys[i + j], hashes[j]);
+    }
+}
+
+
+// Object representing keys hashed by build threads
+typedef struct
+{
+    const hash_t* table;
+    const void* const* keys;
+    uint32_t* hashes;
+    size_t n;
+    size_t next;
+} _build_t;
+
+// Hash claimed ranges of keys
+static void* _build_worker(void* arg)
+{
+    _build_t* build = (_build_t*) arg;
+
+    size_t first;
+    while ((first = __atomic_fetch_add(&build->next, HASH_BUILD_CHUNK, __ATOMIC_RELAXED)) < build->n)
+    {
+        const size_t last = MIN(first + HASH_BUILD_CHUNK, build->n);
+
+        for (size_t i = first; i < last; i += HASH_BATCH_SIZE)
+        {
+            _hash_keys(build->table, &build->keys[i], &build->hashes[i], MIN(last - i, HASH_BATCH_SIZE));
+        }
+    }
+
+    return NULL;
+}
+
+
+// Insert n entries hashing them on nthreads threads (0 uses every core) and sizing an empty table once
+void hash_build(hash_t* table, const void* const* keys, const void* const* data, size_t n, uint32_t nthreads)
+{
+    if (!table || !n) return;
+
+    _build_t build;
+    build.table = table;
+    build.keys = keys;
+    build.hashes = (uint32_t*) malloc(n * sizeof(uint32_t));
+    build.n = n;
+    build.next = 0;
+
+    _parallel(_build_worker, &build, nthreads);
+
+    if (!table->entries && table->backend == &hash_backend_chained)
+    {
+        _chained_build(table, keys, data, build.hashes, n, nthreads);
+        free(build.hashes);
+        return;
+    }
+
+    // Other storage is recreated at its final size and filled with prefetched inserts
+    if (!table->entries)
+    {
+        table->backend->free(table, NULL, NULL);
+        table->backend->init(table, MIN(n, UINT32_MAX));
+    }
+
+    for (size_t i = 0; i < n; i += HASH_BATCH_SIZE)
+    {
+        const size_t m = MIN(n - i, HASH_BATCH_SIZE);
+
+        for (size_t j = 0; j < m; j++) table->backend->prefetch(table, build.hashes[i + j], 0);
+        for (size_t j = 0; j < m; j++) table->backend->prefetch(table, build.hashes[i + j], 1);
+        for (size_t j = 0; j < m; j++) table->backend->insert(table, keys[i + j], data[i + j], build.hashes[i + j]);
+    }
+
+    free(build.hashes);
+}
+
+
+// Print table statistics
+void hash_print_stats(const hash_t* table)
+{
+    if (!table) return;
+
+    table->backend->print_stats(table);
+}
+
+
+// Debug print used to visualize hash table
+void hash_print_debug(const hash_t* table)
+{
+    if (!table) return;
+
+    table->backend->print_debug(table);
+}
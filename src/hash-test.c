@@ -10,6 +10,9 @@
 #include <assert.h>
 
 #include "hash.h"
+#include "hash-table.h"
+
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
 
 double wtime(void);
 void* recalloc(void* p, size_t old_size, size_t new_size);
@@ -17,99 +20,17 @@ double hr_bytes(size_t bytes, char* symbol);
 double hr_seconds(double seconds, char* symbol);
 uint32_t rand32(void);
 uint64_t rand64(void);
+void check_streams(void);
+void check_vectors(void);
+void bench_batches(const char** words, size_t n);
 
-typedef struct node
-{
-    void* key;
-    struct node* next;
-} node_t;
-
-typedef struct
-{
-    uint32_t hash;
-    uint64_t count;
-    node_t* list;
-} pair_t;
-
-typedef struct
-{
-    uint64_t count;
-    uint64_t size;
-    pair_t* array;
-} pairlist_t;
-
-// Return index to the position of entry with specified key O(log N)
-uint64_t pairlist_bsearch(pairlist_t* list, uint32_t hash)
-{
-    pair_t* sorted = list->array;
-
-    uint64_t l = 0;
-    uint64_t u = list->count;
-
-    // Perform a binary search by comparing to middle element
-    while (l < u)
-    {
-        // Update pivot index to be middle of the range
-        uint64_t p = l + ((u - l) >> 1);
-
-        // Use lower half as new range
-        if (hash < sorted[p].hash) u = p;
-        // Use upper half as new range
-        else if (hash > sorted[p].hash) l = p + 1;
-        // Return matching pivot
-        else return p;
-    }
-
-    return l;
-}
-
-// Insert new entry into bucket in sorted order O(N)
-void pairlist_binsert(pairlist_t* list, uint32_t hash, void* key)
-{
-    // Expand bucket memory if necessary
-    if (list->count == list->size || !list->array)
-    {
-        list->size <<= 1;
-        list->array = (pair_t*) realloc(list->array, list->size * sizeof(pair_t));
-    }
-
-    // Determine position to insert at O(log N)
-    uint64_t index = pairlist_bsearch(list, hash);
-    pair_t* array = list->array;
-
-    // Add new node to list for hash
-    // node_t* node = (node_t*) malloc(sizeof(node_t));
-    // node->key = key;
-    // node->next = array[index].list;
-
-    // Update existing entry (duplicates not allowed!)
-    if (index < list->count && hash == array[index].hash)
-    {
-        // array[index].list = node;
-        array[index].count++;
-    }
-    // Insert and shift entries into place O(N)
-    else if (index <= list->count)
-    {
-        memmove(&array[index + 1], &array[index], (list->count++ - index) * sizeof(pair_t));
-        array[index].hash = hash;
-        array[index].count = 1;
-        // array[index].list = node;
-    }
-}
-
-void pairlist_stats(pairlist_t* list)
+// Compare hashes used as keys when counting collisions
+static int _hashcmp(const void* a, const void* b)
 {
-    if (!list) return;
-
-    uint64_t collisions = 0;
+    const uint32_t x = *(const uint32_t*) a;
+    const uint32_t y = *(const uint32_t*) b;
 
-    for (uint64_t i = 0; i < list->count; i++)
-    {
-        collisions += list->array[i].count - 1;
-    }
-
-    printf("collisions: %zu\n", (size_t) collisions);
+    return (x > y) - (x < y);
 }
 
 static inline size_t _filesize(char* path)
@@ -124,12 +45,27 @@ static inline size_t _filesize(char* path)
 
 int main(int argc, char** argv)
 {
-    const char* tests[] = { "hash_fnv1a", "hash_oaat", "hash_murmur3", "hash_xxhash" };
+    const char* tests[] = { "hash_fnv1a", "hash_oaat", "hash_murmur3", "hash_xxhash", "hash_vector", "hash_crc32c" };
+    const char* isas[] = { "scalar", "sse2", "avx2", "avx512" };
+    const size_t ntests = sizeof(tests) / sizeof(tests[0]);
+
+    int first = 1;
+    uint32_t max_threads = 0;
+
+    check_vectors();
+    check_streams();
+
+    // Report tree hashing scaling from 1 to N threads
+    if (argc > 2 && !strcmp(argv[1], "-t"))
+    {
+        max_threads = atoi(argv[2]);
+        first = 3;
+    }
 
     // Hash files from command line
-    for (int c = 1; c < argc; c++)
+    for (int c = first; c < argc; c++)
     {
-        for (size_t i = 0; i < 4; i++)
+        for (size_t i = 0; i < ntests; i++)
         {
             double test_start = 0;
             double test_time = 0;
@@ -145,6 +81,10 @@ int main(int argc, char** argv)
                 hash = hash_murmur3;
             else if (!strcmp(tests[i], "hash_xxhash"))
                 hash = hash_xxhash;
+            else if (!strcmp(tests[i], "hash_vector"))
+                hash = hash_vector;
+            else if (!strcmp(tests[i], "hash_crc32c"))
+                hash = hash_crc32c;
             else
                 hash = NULL;
 
@@ -156,16 +96,48 @@ int main(int argc, char** argv)
             char symbol[8];
             printf("%s [%s]: 0x%zx\n", argv[c], tests[i], (size_t) h);
             printf("%zu bytes over %.2f %ss -> %.1f %sB/s\n", bytes, hr_seconds(test_time, symbol), symbol, hr_bytes(bytes / test_time, symbol + 2), symbol + 2);
+
+            test_start = wtime();
+            h = hash_file_pipeline(argv[c], hash, HASH_FILE_BLOCK_SIZE, HASH_FILE_DEPTH);
+            test_time = wtime() - test_start;
+            printf("pipeline 0x%zx with depth %u -> %.2f GB/s\n", (size_t) h, HASH_FILE_DEPTH, bytes / test_time / 1E9);
+
+            // Report vectorized hash throughput for each instruction set
+            for (size_t j = 0; hash == hash_vector && j < sizeof(isas) / sizeof(isas[0]); j++)
+            {
+                if (hash_vector_select(isas[j])) continue;
+
+                test_start = wtime();
+                h = hash_file(argv[c], hash);
+                test_time = wtime() - test_start;
+
+                printf("%s 0x%zx -> %.2f GB/s\n", hash_vector_isa(), (size_t) h, bytes / test_time / 1E9);
+            }
+
+            hash_vector_select(NULL);
+
+            uint32_t tree = 0;
+
+            for (uint32_t t = 1; t <= max_threads; t++)
+            {
+                test_start = wtime();
+                h = hash_file_parallel(argv[c], hash, t);
+                test_time = wtime() - test_start;
+
+                // Tree hash must not depend on thread count
+                if (t == 1) tree = h;
+                assert(h == tree);
+
+                printf("tree 0x%zx with %u threads -> %.2f GB/s\n", (size_t) h, t, bytes / test_time / 1E9);
+            }
+
             printf("\n");
         }
     }
 
     if (argc < 2)
     {
-        pairlist_t list;
-        list.count = 0;
-        list.size = 1024;
-        list.array = NULL;
+        hash_t counts;
 
         FILE *dict = fopen("words.txt", "r");
         if (!dict)
@@ -184,7 +156,10 @@ int main(int argc, char** argv)
             words[i] = strdup(str);
         }
 
-        for (size_t i = 0; i < 4; i++)
+        // Hashes are stored so the counting table can key on them
+        uint32_t* hashes = (uint32_t*) malloc(466544 * sizeof(uint32_t));
+
+        for (size_t i = 0; i < ntests; i++)
         {
             double test_duration = 5;
             double test_start = 0;
@@ -192,6 +167,8 @@ int main(int argc, char** argv)
             size_t test_cycles = 0;
             size_t j = 0;
             size_t bytes = 0;
+            size_t collisions = 0;
+            uintptr_t most = 0;
 
             uint32_t (*hash)(const void* key, size_t length);
 
@@ -203,9 +180,15 @@ int main(int argc, char** argv)
                 hash = hash_murmur3;
             else if (!strcmp(tests[i], "hash_xxhash"))
                 hash = hash_xxhash;
+            else if (!strcmp(tests[i], "hash_vector"))
+                hash = hash_vector;
+            else if (!strcmp(tests[i], "hash_crc32c"))
+                hash = hash_crc32c;
             else
                 hash = NULL;
 
+            hash_init(&counts, 1024, NULL, _hashcmp, hash_u32, NULL);
+
             do
             {
                 // Generate hash
@@ -215,8 +198,14 @@ int main(int argc, char** argv)
 
                 bytes += strlen(words[j]);
 
-                // Add hash and key to list
-                pairlist_binsert(&list, h, words[j++]);
+                // Count words sharing hash with a single probe
+                int inserted;
+                hashes[j] = h;
+                void** count = hash_find_or_insert(&counts, &hashes[j++], &inserted);
+                *count = (void*) ((uintptr_t) *count + 1);
+
+                collisions += !inserted;
+                if ((uintptr_t) *count > most) most = (uintptr_t) *count;
 
                 // Ran out of words
                 if (j == 466544) break;
@@ -228,19 +217,166 @@ int main(int argc, char** argv)
             char symbol[8];
             printf("%s: %zu iterations over %.2f %ss -> %.4f ns per operation\n", tests[i], test_cycles, hr_seconds(test_time, symbol), symbol, test_time * 1E9 / test_cycles);
             printf("%zu bytes over %.2f s -> %.1f %sB/s\n", bytes, test_time, hr_bytes(bytes / test_time, symbol), symbol);
-            pairlist_stats(&list);
+            printf("collisions: %zu, most words per hash: %zu\n", collisions, (size_t) most);
             printf("\n");
 
-            free(list.array);
-            list.array = NULL;
-            list.count = 0;
+            hash_free(&counts, NULL, NULL);
         }
+
+        free(hashes);
+
+        bench_batches((const char**) words, 466544);
     }
 
     return 0;
 }
 
 
+// Compare batched hashing of dictionary words against one key at a time
+void bench_batches(const char** words, size_t n)
+{
+    size_t* lengths = (size_t*) malloc(n * sizeof(size_t));
+    uint32_t* single = (uint32_t*) malloc(n * sizeof(uint32_t));
+    uint32_t* batch = (uint32_t*) malloc(n * sizeof(uint32_t));
+
+    for (size_t i = 0; i < n; i++) lengths[i] = strlen(words[i]);
+
+    for (size_t i = 0; i < 2; i++)
+    {
+        const char* name = i ? "hash_xxhash" : "hash_murmur3";
+        uint32_t (*hash)(const void*, size_t) = i ? hash_xxhash : hash_murmur3;
+        void (*hash_batch)(const void* const*, const size_t*, uint32_t*, size_t) = i ? hash_xxhash_batch : hash_murmur3_batch;
+
+        double test_start = wtime();
+        for (size_t j = 0; j < n; j++) single[j] = hash(words[j], lengths[j]);
+        double single_time = wtime() - test_start;
+
+        test_start = wtime();
+        hash_batch((const void* const*) words, lengths, batch, n);
+        double batch_time = wtime() - test_start;
+
+        // Batched results must be identical to one key at a time
+        assert(!memcmp(single, batch, n * sizeof(uint32_t)));
+
+        printf("%s_batch: %.4f ns per key (single %.4f ns per key)\n", name, batch_time * 1E9 / n, single_time * 1E9 / n);
+    }
+
+    free(batch);
+    free(single);
+    free(lengths);
+}
+
+
+// Verify hash functions against reference implementation outputs
+void check_vectors(void)
+{
+    const char* fox = "The quick brown fox jumps over the lazy dog";
+
+    assert(hash_crc32c("", 0) == 0x00000000);
+    assert(hash_crc32c("123456789", 9) == 0xE3069283);
+
+    assert(hash_xxhashs("", 0, 0) == 0x02CC5D05);
+    assert(hash_xxhashs("abc", 3, 0) == 0x32D153FF);
+
+    assert(hash_xxhash64s("", 0, 0) == 0xEF46DB3751D8E999ULL);
+    assert(hash_xxhash64s("abc", 3, 0) == 0x44BC2CF5AD770999ULL);
+    assert(hash_xxhash64s(fox, strlen(fox), 0) == 0x0B242D361FDA71BCULL);
+
+    assert(hash_murmur3s("", 0, 0) == 0x00000000);
+    assert(hash_murmur3s("", 0, 1) == 0x514E28B7);
+    assert(hash_murmur3s("Hello, world!", 13, 1234) == 0xFAF6CDB3);
+    assert(hash_murmur3s(fox, strlen(fox), 0x9747B28C) == 0x2FA826CD);
+
+    hash128_t h = hash_murmur3_128s("hello", 5, 0);
+    assert(h.lo == 0xCBD8A7B341BD9B02ULL && h.hi == 0x5B1E906A48AE1D19ULL);
+
+    h = hash_murmur3_128s(fox, strlen(fox), 0);
+    assert(h.lo == 0xE34BBC7BBC071B6CULL && h.hi == 0x7A433CA9C49A9347ULL);
+
+    // Every supported instruction set must agree with scalar around stripe and block boundaries
+    const char* isas[] = { "sse2", "avx2", "avx512" };
+    const size_t lengths[] = { 0, 1, 16, 63, 64, 65, 1023, 1024, 1025, 1087, 1088, 1089, 2048, 4 * HASH_VECTOR_BLOCK };
+    static uint8_t buffer[4 * HASH_VECTOR_BLOCK];
+    for (size_t i = 0; i < sizeof(buffer); i++) buffer[i] = (uint8_t) rand32();
+
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+    {
+        assert(!hash_vector_select("scalar"));
+        const uint32_t expected = hash_vectors(buffer, lengths[i], HASH_SEED);
+
+        for (size_t j = 0; j < sizeof(isas) / sizeof(isas[0]); j++)
+        {
+            if (hash_vector_select(isas[j])) continue;
+            assert(hash_vectors(buffer, lengths[i], HASH_SEED) == expected);
+        }
+    }
+
+    hash_vector_select(NULL);
+}
+
+// Verify incremental hashing matches one-shot hashing for every split point
+void check_streams(void)
+{
+    uint8_t buffer[256];
+    for (size_t i = 0; i < sizeof(buffer); i++) buffer[i] = (uint8_t) rand32();
+
+    for (size_t length = 0; length <= sizeof(buffer); length++)
+    {
+        for (size_t split = 0; split <= length; split++)
+        {
+            hash_fnv1a_state_t fnv1a;
+            hash_fnv1a_init(&fnv1a);
+            hash_fnv1a_update(&fnv1a, buffer, split);
+            hash_fnv1a_update(&fnv1a, buffer + split, length - split);
+            assert(hash_fnv1a_final(&fnv1a) == hash_fnv1a(buffer, length));
+
+            hash_oaat_state_t oaat;
+            hash_oaat_init(&oaat);
+            hash_oaat_update(&oaat, buffer, split);
+            hash_oaat_update(&oaat, buffer + split, length - split);
+            assert(hash_oaat_final(&oaat) == hash_oaat(buffer, length));
+
+            hash_murmur3_state_t murmur3;
+            hash_murmur3_init(&murmur3, HASH_SEED);
+            hash_murmur3_update(&murmur3, buffer, split);
+            hash_murmur3_update(&murmur3, buffer + split, length - split);
+            assert(hash_murmur3_final(&murmur3) == hash_murmur3(buffer, length));
+
+            hash_xxhash_state_t xxhash;
+            hash_xxhash_init(&xxhash, HASH_SEED);
+            hash_xxhash_update(&xxhash, buffer, split);
+            hash_xxhash_update(&xxhash, buffer + split, length - split);
+            assert(hash_xxhash_final(&xxhash) == hash_xxhash(buffer, length));
+        }
+    }
+
+    // Vectorized hash buffers whole blocks so splits are checked around stripe and block boundaries
+    const size_t splits[] = { 0, 1, 63, 64, 65, 1023, 1024, 1025, 1087, 1088, 1089, 2111, 2112, 2113 };
+    static uint8_t block[3 * HASH_VECTOR_BLOCK];
+    for (size_t i = 0; i < sizeof(block); i++) block[i] = (uint8_t) rand32();
+
+    for (size_t length = 0; length <= sizeof(block); length += length < 2200 ? 1 : 97)
+    {
+        const uint32_t expected = hash_vectors(block, length, HASH_SEED);
+
+        for (size_t i = 0; i < sizeof(splits) / sizeof(splits[0]) && splits[i] <= length; i++)
+        {
+            hash_vector_state_t vector;
+            hash_vector_init(&vector, HASH_SEED);
+            hash_vector_update(&vector, block, splits[i]);
+            hash_vector_update(&vector, block + splits[i], length - splits[i]);
+            assert(hash_vector_final(&vector) == expected);
+        }
+
+        // Many small updates cross every boundary
+        hash_vector_state_t vector;
+        hash_vector_init(&vector, HASH_SEED);
+        for (size_t offset = 0; offset < length; offset += 100) hash_vector_update(&vector, block + offset, MIN(length - offset, 100));
+        assert(hash_vector_final(&vector) == expected);
+    }
+}
+
+
 // walltime of the computer in seconds (useful for performance analysis)
 double wtime(void)
 {
@@ -9,11 +9,47 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <assert.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+// SIMD kernels assume 64-bit pointers and registers so 32-bit x86 uses the portable code
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HASH_X86 1
+#endif
 
 #include "hash.h"
 
-#define HASH_SEED (uint32_t) 0xDEADBEEF
-#define HASH_BLOCK_SIZE (1 << 20)
+#define HASH_MAP_WINDOW (1 << 23)
+#define HASH_CHUNK_SIZE (1 << 22)
+
+#define MURMUR3_C1 0xCC9E2D51U
+#define MURMUR3_C2 0x1B873593U
+
+#define XXH32_P1 2654435761U
+#define XXH32_P2 2246822519U
+#define XXH32_P3 3266489917U
+#define XXH32_P4  668265265U
+#define XXH32_P5  374761393U
+
+#define MURMUR3_C3 0x87C37B91114253D5ULL
+#define MURMUR3_C4 0x4CF5AD432745937FULL
+
+#define XXH64_P1 11400714785074694791ULL
+#define XXH64_P2 14029467366897019727ULL
+#define XXH64_P3  1609587929392839161ULL
+#define XXH64_P4  9650029242287828579ULL
+#define XXH64_P5  2870177450012600261ULL
+
+#define VECTOR_LANES 8
+#define VECTOR_STRIPES (HASH_VECTOR_BLOCK / HASH_VECTOR_STRIPE)
+#define VECTOR_LAST 9
+#define VECTOR_MERGE 11
+#define VECTOR_SCRAMBLE 24
+
+#define BATCH_LANES 8
+#define BATCH_MAX_LENGTH 256
 
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
@@ -68,13 +104,272 @@ static inline uint64_t _read64(const void* p)
     return _lsb() ? x : _swap64(x);
 }
 
-static inline size_t _filesize(const char* path)
+static uint32_t _crc32c_update(uint32_t crc, const void* key, size_t length);
+
+// Object representing the incremental state of any hash function
+typedef struct
+{
+    uint32_t (*hash)(const void*, size_t);
+
+    union
+    {
+        hash_fnv1a_state_t fnv1a;
+        hash_oaat_state_t oaat;
+        hash_murmur3_state_t murmur3;
+        hash_xxhash_state_t xxhash;
+        hash_vector_state_t vector;
+        uint32_t crc32c;
+    };
+
+    // Fallback storage for functions without incremental form
+    uint8_t* buffer;
+    size_t count;
+    size_t size;
+} _stream_t;
+
+// Initialize incremental state for specified hash function
+static void _stream_init(_stream_t* stream, uint32_t (*hash)(const void*, size_t))
+{
+    stream->hash = hash;
+    stream->buffer = NULL;
+    stream->count = 0;
+    stream->size = 0;
+
+    if (hash == hash_fnv1a) hash_fnv1a_init(&stream->fnv1a);
+    else if (hash == hash_oaat) hash_oaat_init(&stream->oaat);
+    else if (hash == hash_murmur3) hash_murmur3_init(&stream->murmur3, HASH_SEED);
+    else if (hash == hash_xxhash) hash_xxhash_init(&stream->xxhash, HASH_SEED);
+    else if (hash == hash_vector) hash_vector_init(&stream->vector, HASH_SEED);
+    else if (hash == hash_crc32c) stream->crc32c = 0xFFFFFFFF;
+}
+
+// Return whether hash function has an incremental form
+static inline int _stream_incremental(uint32_t (*hash)(const void*, size_t))
+{
+    return hash == hash_fnv1a || hash == hash_oaat || hash == hash_murmur3 || hash == hash_xxhash || hash == hash_vector || hash == hash_crc32c;
+}
+
+// Add bytes to incremental state
+static void _stream_update(_stream_t* stream, const void* key, size_t length)
+{
+    uint32_t (*const hash)(const void*, size_t) = stream->hash;
+
+    if (hash == hash_fnv1a) hash_fnv1a_update(&stream->fnv1a, key, length);
+    else if (hash == hash_oaat) hash_oaat_update(&stream->oaat, key, length);
+    else if (hash == hash_murmur3) hash_murmur3_update(&stream->murmur3, key, length);
+    else if (hash == hash_xxhash) hash_xxhash_update(&stream->xxhash, key, length);
+    else if (hash == hash_vector) hash_vector_update(&stream->vector, key, length);
+    else if (hash == hash_crc32c) stream->crc32c = _crc32c_update(stream->crc32c, key, length);
+    else
+    {
+        // Accumulate bytes so the hash can be computed in one call
+        if (stream->count + length > stream->size)
+        {
+            stream->size = MAX(stream->count + length, stream->size * 2);
+            stream->buffer = (uint8_t*) realloc(stream->buffer, stream->size);
+        }
+
+        memcpy(stream->buffer + stream->count, key, length);
+        stream->count += length;
+    }
+}
+
+// Compute hash of all bytes added to state and release resources
+static uint32_t _stream_final(_stream_t* stream)
+{
+    uint32_t (*const hash)(const void*, size_t) = stream->hash;
+    uint32_t h;
+
+    if (hash == hash_fnv1a) h = hash_fnv1a_final(&stream->fnv1a);
+    else if (hash == hash_oaat) h = hash_oaat_final(&stream->oaat);
+    else if (hash == hash_murmur3) h = hash_murmur3_final(&stream->murmur3);
+    else if (hash == hash_xxhash) h = hash_xxhash_final(&stream->xxhash);
+    else if (hash == hash_vector) h = hash_vector_final(&stream->vector);
+    else if (hash == hash_crc32c) h = ~stream->crc32c;
+    else h = stream->hash(stream->buffer, stream->count);
+
+    free(stream->buffer);
+    stream->buffer = NULL;
+
+    return h;
+}
+
+
+// Object representing a read-ahead queue of file blocks
+typedef struct
+{
+    int fd;
+    size_t block_size;
+    uint32_t depth;
+    uint8_t** buffers;
+    ssize_t* lengths;
+
+    uint32_t head;
+    uint32_t tail;
+    uint32_t count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t filled;
+    pthread_cond_t emptied;
+} _pipeline_t;
+
+// Read file blocks into free queue buffers until end of file
+static void* _pipeline_reader(void* arg)
+{
+    _pipeline_t* pipeline = (_pipeline_t*) arg;
+    ssize_t status;
+
+    do
+    {
+        // Wait for a free buffer
+        pthread_mutex_lock(&pipeline->lock);
+        while (pipeline->count == pipeline->depth) pthread_cond_wait(&pipeline->emptied, &pipeline->lock);
+        const uint32_t index = pipeline->tail;
+        pthread_mutex_unlock(&pipeline->lock);
+
+        status = read(pipeline->fd, pipeline->buffers[index], pipeline->block_size);
+
+        // Publish filled buffer (end of file is published as an empty block)
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->lengths[index] = status;
+        pipeline->tail = (index + 1) % pipeline->depth;
+        pipeline->count++;
+        pthread_cond_signal(&pipeline->filled);
+        pthread_mutex_unlock(&pipeline->lock);
+    } while (status > 0);
+
+    return NULL;
+}
+
+// Compute hash of a file descriptor's contents using buffered reads
+static uint32_t _hash_fd_read(int fd, uint32_t (*hash)(const void*, size_t), size_t block_size, uint32_t depth)
+{
+    _stream_t stream;
+    _pipeline_t pipeline;
+    pthread_t reader;
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    block_size = block_size ? block_size : HASH_FILE_BLOCK_SIZE;
+    depth = MAX(depth, 1);
+
+    pipeline.fd = fd;
+    pipeline.block_size = block_size;
+    pipeline.depth = depth;
+    pipeline.buffers = (uint8_t**) malloc(depth * sizeof(uint8_t*));
+    pipeline.lengths = (ssize_t*) malloc(depth * sizeof(ssize_t));
+    pipeline.head = 0;
+    pipeline.tail = 0;
+    pipeline.count = 0;
+
+    for (uint32_t i = 0; i < depth; i++)
+    {
+        pipeline.buffers[i] = (uint8_t*) malloc(block_size);
+    }
+
+    _stream_init(&stream, hash);
+
+    // Overlap reading the next blocks with hashing the current one
+    if (depth > 1 && !pthread_mutex_init(&pipeline.lock, NULL))
+    {
+        pthread_cond_init(&pipeline.filled, NULL);
+        pthread_cond_init(&pipeline.emptied, NULL);
+
+        if (pthread_create(&reader, NULL, _pipeline_reader, &pipeline))
+        {
+            // Read synchronously if reader thread is unavailable
+            depth = 1;
+        }
+        else
+        {
+            ssize_t length;
+
+            do
+            {
+                pthread_mutex_lock(&pipeline.lock);
+                while (!pipeline.count) pthread_cond_wait(&pipeline.filled, &pipeline.lock);
+                const uint32_t index = pipeline.head;
+                pthread_mutex_unlock(&pipeline.lock);
+
+                length = pipeline.lengths[index];
+                if (length > 0) _stream_update(&stream, pipeline.buffers[index], length);
+
+                // Return buffer to reader
+                pthread_mutex_lock(&pipeline.lock);
+                pipeline.head = (index + 1) % pipeline.depth;
+                pipeline.count--;
+                pthread_cond_signal(&pipeline.emptied);
+                pthread_mutex_unlock(&pipeline.lock);
+            } while (length > 0);
+
+            pthread_join(reader, NULL);
+        }
+
+        pthread_cond_destroy(&pipeline.emptied);
+        pthread_cond_destroy(&pipeline.filled);
+        pthread_mutex_destroy(&pipeline.lock);
+    }
+    else
+    {
+        depth = 1;
+    }
+
+    if (depth == 1)
+    {
+        // Feed each block into a single digest
+        ssize_t status;
+        while ((status = read(fd, pipeline.buffers[0], block_size)) > 0)
+        {
+            _stream_update(&stream, pipeline.buffers[0], status);
+        }
+    }
+
+    for (uint32_t i = 0; i < pipeline.depth; i++)
+    {
+        free(pipeline.buffers[i]);
+    }
+
+    free(pipeline.lengths);
+    free(pipeline.buffers);
+
+    return _stream_final(&stream);
+}
+
+// Compute hash of a regular file's contents directly from the page cache
+static int _hash_fd_mmap(int fd, size_t size, uint32_t (*hash)(const void*, size_t), uint32_t* h)
 {
-    FILE* f = fopen(path, "rb");
-    fseek(f, 0, SEEK_END);
-    const size_t size = ftell(f);
-    fclose(f);
-    return size;
+    uint8_t* const map = (uint8_t*) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) return 0;
+
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    if (_stream_incremental(hash))
+    {
+        _stream_t stream;
+        _stream_init(&stream, hash);
+
+        // Request the next window while hashing the current one
+        madvise(map, MIN(size, HASH_MAP_WINDOW), MADV_WILLNEED);
+
+        for (size_t offset = 0; offset < size; offset += HASH_MAP_WINDOW)
+        {
+            const size_t next = offset + HASH_MAP_WINDOW;
+            if (next < size) madvise(map + next, MIN(size - next, HASH_MAP_WINDOW), MADV_WILLNEED);
+
+            _stream_update(&stream, map + offset, MIN(size - offset, HASH_MAP_WINDOW));
+        }
+
+        *h = _stream_final(&stream);
+    }
+    else
+    {
+        madvise(map, size, MADV_WILLNEED);
+        *h = hash(map, size);
+    }
+
+    munmap(map, size);
+
+    return 1;
 }
 
 
@@ -82,25 +377,175 @@ static inline size_t _filesize(const char* path)
 uint32_t hash_file(const char* path, uint32_t (*hash)(const void*, size_t))
 {
     uint32_t h = 0;
-    size_t length = _filesize(path);
+    struct stat info;
+    hash = hash ? hash : hash_murmur3;
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return h;
+
+    // Map regular files and fall back to reads for pipes and special files
+    const int mappable = !fstat(fd, &info) && S_ISREG(info.st_mode) && info.st_size > 0;
+
+    if (!mappable || !_hash_fd_mmap(fd, info.st_size, hash, &h))
+    {
+        h = _hash_fd_read(fd, hash, HASH_FILE_BLOCK_SIZE, HASH_FILE_DEPTH);
+    }
+
+    close(fd);
+
+    return h;
+}
+
+
+// Compute 32-bit hash of files contents reading blocks ahead of hashing
+uint32_t hash_file_pipeline(const char* path, uint32_t (*hash)(const void*, size_t), size_t block_size, uint32_t depth)
+{
+    uint32_t h = 0;
+    hash = hash ? hash : hash_murmur3;
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return h;
+
+    h = _hash_fd_read(fd, hash, block_size, depth);
+
+    close(fd);
+
+    return h;
+}
+
+
+// Object representing work shared by tree hashing threads
+typedef struct
+{
+    uint32_t (*hash)(const void*, size_t);
+    const uint8_t* map;
+    size_t size;
+    size_t chunks;
+    size_t next;
+    uint32_t* digests;
+} _tree_t;
+
+// Hash chunks claimed from shared counter until none remain
+static void* _tree_worker(void* arg)
+{
+    _tree_t* tree = (_tree_t*) arg;
+
+    size_t i;
+    while ((i = __atomic_fetch_add(&tree->next, 1, __ATOMIC_RELAXED)) < tree->chunks)
+    {
+        const size_t offset = i * HASH_CHUNK_SIZE;
+        tree->digests[i] = tree->hash(tree->map + offset, MIN(tree->size - offset, HASH_CHUNK_SIZE));
+    }
+
+    return NULL;
+}
+
+// Combine chunk digests pairwise in order until a single root remains
+static uint32_t _tree_reduce(uint32_t (*hash)(const void*, size_t), uint32_t* digests, size_t count)
+{
+    while (count > 1)
+    {
+        size_t j = 0;
+
+        for (size_t i = 0; i + 1 < count; i += 2)
+        {
+            uint8_t pair[8];
+
+            for (int b = 0; b < 4; b++)
+            {
+                pair[b] = digests[i] >> (8 * b);
+                pair[b + 4] = digests[i + 1] >> (8 * b);
+            }
+
+            digests[j++] = hash(pair, sizeof(pair));
+        }
+
+        // Promote unpaired digest to next level
+        if (count & 1) digests[j++] = digests[count - 1];
+
+        count = j;
+    }
+
+    return digests[0];
+}
+
+
+// Compute 32-bit tree hash of files contents using multiple threads
+uint32_t hash_file_parallel(const char* path, uint32_t (*hash)(const void*, size_t), uint32_t nthreads)
+{
+    uint32_t h = 0;
+    struct stat info;
     hash = hash ? hash : hash_murmur3;
+    nthreads = nthreads ? nthreads : MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
 
     const int fd = open(path, O_RDONLY);
-    uint8_t* const buffer = (uint8_t*) malloc(HASH_BLOCK_SIZE);
+    if (fd < 0) return h;
 
-    ssize_t status = 1;
-    while (length && status > 0)
+    if (fstat(fd, &info) || !S_ISREG(info.st_mode) || info.st_size == 0)
     {
-        const size_t read_size = MIN(length, HASH_BLOCK_SIZE);
+        close(fd);
+        return hash_file(path, hash);
+    }
+
+    _tree_t tree;
+    tree.hash = hash;
+    tree.size = info.st_size;
+    tree.chunks = (tree.size + HASH_CHUNK_SIZE - 1) / HASH_CHUNK_SIZE;
+    tree.next = 0;
+    tree.digests = (uint32_t*) malloc(tree.chunks * sizeof(uint32_t));
+    tree.map = (const uint8_t*) mmap(NULL, tree.size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (tree.map != MAP_FAILED)
+    {
+        madvise((void*) tree.map, tree.size, MADV_WILLNEED);
+
+        // Hash chunks on worker threads and the calling thread
+        nthreads = MIN(nthreads, tree.chunks);
+        pthread_t* threads = (pthread_t*) malloc(nthreads * sizeof(pthread_t));
+
+        uint32_t spawned = 1;
+        for (; spawned < nthreads; spawned++)
+        {
+            if (pthread_create(&threads[spawned], NULL, _tree_worker, &tree)) break;
+        }
+
+        _tree_worker(&tree);
 
-        status = read(fd, buffer, read_size);
+        for (uint32_t i = 1; i < spawned; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+
+        free(threads);
+        munmap((void*) tree.map, tree.size);
+    }
+    else
+    {
+        // Hash same chunks serially when the file cannot be mapped
+        uint8_t* const buffer = (uint8_t*) malloc(HASH_CHUNK_SIZE);
 
-        h ^= hash(buffer, read_size);
+        for (size_t i = 0; i < tree.chunks; i++)
+        {
+            const size_t offset = i * HASH_CHUNK_SIZE;
+            const size_t length = MIN(tree.size - offset, HASH_CHUNK_SIZE);
+            size_t count = 0;
+
+            while (count < length)
+            {
+                const ssize_t status = pread(fd, buffer + count, length - count, offset + count);
+                if (status <= 0) break;
+                count += status;
+            }
 
-        length -= read_size;
+            tree.digests[i] = hash(buffer, count);
+        }
+
+        free(buffer);
     }
 
-    free(buffer);
+    h = _tree_reduce(hash, tree.digests, tree.chunks);
+
+    free(tree.digests);
     close(fd);
 
     return h;
@@ -109,23 +554,60 @@ uint32_t hash_file(const char* path, uint32_t (*hash)(const void*, size_t))
 
 // Compute 32-bit FNV1A hash
 uint32_t hash_fnv1a(const void* key, size_t length)
+{
+    hash_fnv1a_state_t state;
+    hash_fnv1a_init(&state);
+    hash_fnv1a_update(&state, key, length);
+    return hash_fnv1a_final(&state);
+}
+
+// Initialize incremental 32-bit FNV1A hash state
+void hash_fnv1a_init(hash_fnv1a_state_t* state)
+{
+    state->h = 2166136261;
+}
+
+// Add bytes to incremental 32-bit FNV1A hash state
+void hash_fnv1a_update(hash_fnv1a_state_t* state, const void* key, size_t length)
 {
     const uint8_t* k = (const uint8_t*) key;
-    uint32_t h = 2166136261;
+    uint32_t h = state->h;
 
     for (size_t i = 0; i < length; i++)
     {
         h = (h ^ k[i]) * 16777619;
     }
 
-    return h;
+    state->h = h;
+}
+
+// Compute 32-bit FNV1A hash of all bytes added to state
+uint32_t hash_fnv1a_final(const hash_fnv1a_state_t* state)
+{
+    return state->h;
 }
 
+
 // Compute 32-bit jenkins one-at-a-time hash
 uint32_t hash_oaat(const void* key, size_t length)
+{
+    hash_oaat_state_t state;
+    hash_oaat_init(&state);
+    hash_oaat_update(&state, key, length);
+    return hash_oaat_final(&state);
+}
+
+// Initialize incremental 32-bit jenkins one-at-a-time hash state
+void hash_oaat_init(hash_oaat_state_t* state)
+{
+    state->h = 0;
+}
+
+// Add bytes to incremental 32-bit jenkins one-at-a-time hash state
+void hash_oaat_update(hash_oaat_state_t* state, const void* key, size_t length)
 {
     const uint8_t* k = (const uint8_t*) key;
-    uint32_t h = 0;
+    uint32_t h = state->h;
 
     for (size_t i = 0; i < length; i++)
     {
@@ -134,6 +616,14 @@ uint32_t hash_oaat(const void* key, size_t length)
         h ^= h >> 6;
     }
 
+    state->h = h;
+}
+
+// Compute 32-bit jenkins one-at-a-time hash of all bytes added to state
+uint32_t hash_oaat_final(const hash_oaat_state_t* state)
+{
+    uint32_t h = state->h;
+
     h += h << 3;
     h ^= h >> 11;
     h += h << 15;
@@ -141,50 +631,130 @@ uint32_t hash_oaat(const void* key, size_t length)
     return h;
 }
 
-// Compute 32-bit murmur3 hash with constant seed
-uint32_t hash_murmur3(const void* key, size_t length)
+
+// Slicing-by-8 tables for software CRC32C
+static uint32_t _crc32c_table[8][256];
+
+static uint32_t (*_crc32c_kernel)(uint32_t, const uint8_t*, size_t) = NULL;
+static pthread_once_t _crc32c_once = PTHREAD_ONCE_INIT;
+
+// Update CRC32C 8 bytes at a time using lookup tables
+static uint32_t _crc32c_software(uint32_t crc, const uint8_t* k, size_t length)
 {
-    return hash_murmur3s(key, length, HASH_SEED);
+    while (length >= 8)
+    {
+        const uint64_t x = _read64(k) ^ crc;
+
+        crc = _crc32c_table[7][ x        & 0xFF] ^
+              _crc32c_table[6][(x >>  8) & 0xFF] ^
+              _crc32c_table[5][(x >> 16) & 0xFF] ^
+              _crc32c_table[4][(x >> 24) & 0xFF] ^
+              _crc32c_table[3][(x >> 32) & 0xFF] ^
+              _crc32c_table[2][(x >> 40) & 0xFF] ^
+              _crc32c_table[1][(x >> 48) & 0xFF] ^
+              _crc32c_table[0][ x >> 56        ];
+
+        k += 8;
+        length -= 8;
+    }
+
+    while (length--)
+    {
+        crc = _crc32c_table[0][(crc ^ *k++) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
 }
 
-// Compute 32-bit murmur3 hash with seed
-uint32_t hash_murmur3s(const void* key, size_t length, uint32_t seed)
+#ifdef HASH_X86
+// Update CRC32C 8 bytes at a time using SSE4.2 crc32 instruction
+__attribute__((target("sse4.2")))
+static uint32_t _crc32c_sse42(uint32_t crc, const uint8_t* k, size_t length)
 {
-    static const uint32_t c1 = 0xCC9E2D51;
-    static const uint32_t c2 = 0x1B873593;
+    uint64_t c = crc;
 
-    const uint8_t* k = (const uint8_t*) key;
-    uint32_t h = seed;
+    while (length >= 8)
+    {
+        c = _mm_crc32_u64(c, _read64(k));
+        k += 8;
+        length -= 8;
+    }
 
-    const size_t nblocks = length / 4;
-    const uint8_t* tail = k + nblocks * 4;
+    crc = (uint32_t) c;
 
-    while (k < tail)
+    while (length--)
     {
-        uint32_t k1 = _read32(k); k += 4;
+        crc = _mm_crc32_u8(crc, *k++);
+    }
 
-        k1 *= c1;
-        k1 = _rotl32(k1, 15);
-        k1 *= c2;
+    return crc;
+}
+#endif
 
-        h ^= k1;
-        h = _rotl32(h, 13);
-        h = h * 5 + 0xE6546B64;
+// Build lookup tables and select CRC32C implementation
+static void _crc32c_setup(void)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) crc = (crc >> 1) ^ (0x82F63B78 & -(crc & 1));
+        _crc32c_table[0][i] = crc;
     }
 
-    uint32_t k1 = 0;
-
-    switch (length & 3)
+    for (uint32_t i = 0; i < 256; i++)
     {
-        case 3: k1 ^= tail[2] << 16;
-        case 2: k1 ^= tail[1] << 8;
-        case 1: k1 ^= tail[0];
-                k1 *= c1;
-                k1 = _rotl32(k1, 15);
-                k1 *= c2;
-                h ^= k1;
+        for (int j = 1; j < 8; j++)
+        {
+            const uint32_t crc = _crc32c_table[j - 1][i];
+            _crc32c_table[j][i] = _crc32c_table[0][crc & 0xFF] ^ (crc >> 8);
+        }
     }
 
+    _crc32c_kernel = _crc32c_software;
+
+#ifdef HASH_X86
+    if (__builtin_cpu_supports("sse4.2")) _crc32c_kernel = _crc32c_sse42;
+#endif
+}
+
+// Update raw CRC32C value with bytes
+static uint32_t _crc32c_update(uint32_t crc, const void* key, size_t length)
+{
+    pthread_once(&_crc32c_once, _crc32c_setup);
+    return _crc32c_kernel(crc, (const uint8_t*) key, length);
+}
+
+// Compute 32-bit CRC32C (Castagnoli) hash
+uint32_t hash_crc32c(const void* key, size_t length)
+{
+    return ~_crc32c_update(0xFFFFFFFF, key, length);
+}
+
+
+// Mix a 4 byte block into murmur3 hash
+static inline uint32_t _murmur3_block(uint32_t h, uint32_t k1)
+{
+    k1 *= MURMUR3_C1;
+    k1 = _rotl32(k1, 15);
+    k1 *= MURMUR3_C2;
+
+    h ^= k1;
+    h = _rotl32(h, 13);
+    return h * 5 + 0xE6546B64;
+}
+
+// Mix tail bytes (packed little endian) into murmur3 hash
+static inline uint32_t _murmur3_tail(uint32_t h, uint32_t k1)
+{
+    k1 *= MURMUR3_C1;
+    k1 = _rotl32(k1, 15);
+    k1 *= MURMUR3_C2;
+    return h ^ k1;
+}
+
+// Finalize murmur3 hash
+static inline uint32_t _murmur3_fmix(uint32_t h, size_t length)
+{
     h ^= (uint32_t) length;
     h ^= h >> 16;
     h *= 0x85EBCA6B;
@@ -195,65 +765,301 @@ uint32_t hash_murmur3s(const void* key, size_t length, uint32_t seed)
     return h;
 }
 
-// Compute 32-bit xxHash with constant seed
-uint32_t hash_xxhash(const void* key, size_t length)
+// Mix remaining bytes and finalize murmur3 hash
+static inline uint32_t _murmur3_final(uint32_t h, const uint8_t* tail, size_t length)
 {
-    return hash_xxhashs(key, length, HASH_SEED);
+    uint32_t k1 = 0;
+
+    switch (length & 3)
+    {
+        case 3: k1 ^= tail[2] << 16;
+        case 2: k1 ^= tail[1] << 8;
+        case 1: k1 ^= tail[0];
+                h = _murmur3_tail(h, k1);
+    }
+
+    return _murmur3_fmix(h, length);
 }
 
-// Compute 32-bit xxHash with seed
-uint32_t hash_xxhashs(const void* key, size_t length, uint32_t seed)
+// Compute 32-bit murmur3 hash of inputs up to 16 bytes
+static inline uint32_t _murmur3_short(const uint8_t* k, size_t length, uint32_t seed)
 {
-    static const uint32_t p1 = 2654435761U;
-    static const uint32_t p2 = 2246822519U;
-    static const uint32_t p3 = 3266489917U;
-    static const uint32_t p4 =  668265265U;
-    static const uint32_t p5 =  374761393U;
-
-    const uint8_t* k = (const uint8_t*) key;
-    uint32_t h = seed + p5;
-    const uint8_t* end = k + length;
+    uint32_t h = seed;
+    uint32_t k1 = 0;
 
-    if (length >= 16)
+    if (length >= 4)
     {
-        const uint8_t* limit = end - 15;
+        // Tail bytes are the high bytes of the last (overlapping) word
+        const uint32_t last = _read32(k + length - 4);
+        const uint32_t rest = length & 3;
 
-        uint32_t v1 = seed + p1 + p2;
-        uint32_t v2 = seed + p2;
-        uint32_t v3 = seed + 0;
-        uint32_t v4 = seed - p1;
+        h = _murmur3_block(h, _read32(k));
+        if (length >= 8) h = _murmur3_block(h, _read32(k + 4));
+        if (length >= 12) h = _murmur3_block(h, _read32(k + 8));
+        if (length >= 16) h = _murmur3_block(h, _read32(k + 12));
 
-#define PROCESS0(x, y)      \
-        x += y * p2;        \
-        x = _rotl32(x, 13); \
-        x *= p1;
+        if (rest) k1 = last >> (8 * (4 - rest));
+    }
+    else if (length)
+    {
+        // First, middle and last bytes cover 1 to 3 byte inputs
+        k1 = (k[0] | (k[length >> 1] << 8) | (k[length - 1] << 16)) & ((1U << (8 * length)) - 1);
+    }
 
-        do
-        {
-            // v1 = round(v1, _read32(k)); k += 4;
-            // v2 = round(v2, _read32(k)); k += 4;
-            // v3 = round(v3, _read32(k)); k += 4;
-            // v4 = round(v4, _read32(k)); k += 4;
-            PROCESS0(v1, _read32(k)); k += 4;
-            PROCESS0(v2, _read32(k)); k += 4;
-            PROCESS0(v3, _read32(k)); k += 4;
-            PROCESS0(v4, _read32(k)); k += 4;
-        } while (k < limit);
+    // An empty tail mixes in zero which leaves the hash unchanged
+    h = _murmur3_tail(h, k1);
 
-        h = _rotl32(v1, 1) + _rotl32(v2, 7) + _rotl32(v3, 12) + _rotl32(v4, 18);
+    return _murmur3_fmix(h, length);
+}
+
+// Finalize 64-bit murmur3 lane
+static inline uint64_t _murmur3_fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xFF51AFD7ED558CCDULL;
+    k ^= k >> 33;
+    k *= 0xC4CEB9FE1A85EC53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// Compute 32-bit hash of a 32-bit integer key (murmur3 finalizer)
+uint32_t hash_u32(const void* key, size_t length)
+{
+    uint32_t h;
+    memcpy(&h, key, sizeof(h));
+
+    return _murmur3_fmix(h, 0);
+}
+
+// Compute 32-bit hash of a 64-bit integer key (murmur3 64-bit finalizer)
+uint32_t hash_u64(const void* key, size_t length)
+{
+    uint64_t h;
+    memcpy(&h, key, sizeof(h));
+
+    return (uint32_t) _murmur3_fmix64(h);
+}
+
+// Compute 32-bit multiplicative hash of a 32-bit integer key
+uint32_t hash_u32_ms(const void* key, size_t length)
+{
+    uint32_t x;
+    memcpy(&x, key, sizeof(x));
+
+    return (uint32_t) ((x * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+// Compute 32-bit multiplicative hash of a 64-bit integer key
+uint32_t hash_u64_ms(const void* key, size_t length)
+{
+    uint64_t x;
+    memcpy(&x, key, sizeof(x));
+
+    return (uint32_t) ((x * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+
+// Compute 32-bit murmur3 hash with constant seed
+uint32_t hash_murmur3(const void* key, size_t length)
+{
+    return hash_murmur3s(key, length, HASH_SEED);
+}
+
+// Compute 32-bit murmur3 hash with seed
+uint32_t hash_murmur3s(const void* key, size_t length, uint32_t seed)
+{
+    const uint8_t* k = (const uint8_t*) key;
+    uint32_t h = seed;
+
+    if (length <= 16) return _murmur3_short(k, length, seed);
+
+    const size_t nblocks = length / 4;
+    const uint8_t* tail = k + nblocks * 4;
+
+    while (k < tail)
+    {
+        h = _murmur3_block(h, _read32(k)); k += 4;
     }
 
-    h += (uint32_t) length;
+    return _murmur3_final(h, tail, length);
+}
+
+// Initialize incremental 32-bit murmur3 hash state with seed
+void hash_murmur3_init(hash_murmur3_state_t* state, uint32_t seed)
+{
+    state->h = seed;
+    state->count = 0;
+    state->length = 0;
+}
+
+// Add bytes to incremental 32-bit murmur3 hash state
+void hash_murmur3_update(hash_murmur3_state_t* state, const void* key, size_t length)
+{
+    const uint8_t* k = (const uint8_t*) key;
+    const uint8_t* end = k + length;
+    uint32_t h = state->h;
 
-#define PROCESS1    \
-    h += (*k) * p5; \
-    k++;            \
-    h = _rotl32(h, 11) * p1;
+    state->length += length;
+
+    // Complete previously buffered block
+    if (state->count)
+    {
+        const size_t fill = MIN(length, 4 - state->count);
+        memcpy(state->buffer + state->count, k, fill);
+        state->count += fill;
+        k += fill;
 
-#define PROCESS2          \
-    h += _read32(k) * p3; \
-    k += 4;               \
-    h = _rotl32(h, 17) * p4;
+        if (state->count < 4) return;
+
+        h = _murmur3_block(h, _read32(state->buffer));
+        state->count = 0;
+    }
+
+    while (k + 4 <= end)
+    {
+        h = _murmur3_block(h, _read32(k)); k += 4;
+    }
+
+    // Buffer remaining bytes for next update
+    state->count = end - k;
+    memcpy(state->buffer, k, state->count);
+    state->h = h;
+}
+
+// Compute 32-bit murmur3 hash of all bytes added to state
+uint32_t hash_murmur3_final(const hash_murmur3_state_t* state)
+{
+    return _murmur3_final(state->h, state->buffer, state->length);
+}
+
+
+// Compute 128-bit murmur3 hash with constant seed
+hash128_t hash_murmur3_128(const void* key, size_t length)
+{
+    return hash_murmur3_128s(key, length, HASH_SEED);
+}
+
+// Compute 128-bit murmur3 hash with seed
+hash128_t hash_murmur3_128s(const void* key, size_t length, uint32_t seed)
+{
+    const uint8_t* k = (const uint8_t*) key;
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+
+    const size_t nblocks = length / 16;
+    const uint8_t* tail = k + nblocks * 16;
+
+    while (k < tail)
+    {
+        uint64_t k1 = _read64(k); k += 8;
+        uint64_t k2 = _read64(k); k += 8;
+
+        k1 *= MURMUR3_C3;
+        k1 = _rotl64(k1, 31);
+        k1 *= MURMUR3_C4;
+        h1 ^= k1;
+
+        h1 = _rotl64(h1, 27);
+        h1 += h2;
+        h1 = h1 * 5 + 0x52DCE729;
+
+        k2 *= MURMUR3_C4;
+        k2 = _rotl64(k2, 33);
+        k2 *= MURMUR3_C3;
+        h2 ^= k2;
+
+        h2 = _rotl64(h2, 31);
+        h2 += h1;
+        h2 = h2 * 5 + 0x38495AB5;
+    }
+
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+
+    switch (length & 15)
+    {
+        case 15: k2 ^= (uint64_t) tail[14] << 48;
+        case 14: k2 ^= (uint64_t) tail[13] << 40;
+        case 13: k2 ^= (uint64_t) tail[12] << 32;
+        case 12: k2 ^= (uint64_t) tail[11] << 24;
+        case 11: k2 ^= (uint64_t) tail[10] << 16;
+        case 10: k2 ^= (uint64_t) tail[ 9] << 8;
+        case  9: k2 ^= (uint64_t) tail[ 8];
+                 k2 *= MURMUR3_C4;
+                 k2 = _rotl64(k2, 33);
+                 k2 *= MURMUR3_C3;
+                 h2 ^= k2;
+
+        case  8: k1 ^= (uint64_t) tail[ 7] << 56;
+        case  7: k1 ^= (uint64_t) tail[ 6] << 48;
+        case  6: k1 ^= (uint64_t) tail[ 5] << 40;
+        case  5: k1 ^= (uint64_t) tail[ 4] << 32;
+        case  4: k1 ^= (uint64_t) tail[ 3] << 24;
+        case  3: k1 ^= (uint64_t) tail[ 2] << 16;
+        case  2: k1 ^= (uint64_t) tail[ 1] << 8;
+        case  1: k1 ^= (uint64_t) tail[ 0];
+                 k1 *= MURMUR3_C3;
+                 k1 = _rotl64(k1, 31);
+                 k1 *= MURMUR3_C4;
+                 h1 ^= k1;
+    }
+
+    h1 ^= (uint64_t) length;
+    h2 ^= (uint64_t) length;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = _murmur3_fmix64(h1);
+    h2 = _murmur3_fmix64(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    const hash128_t h = { h1, h2 };
+    return h;
+}
+
+// Process a 4 byte lane of xxHash
+static inline uint32_t _xxhash_round(uint32_t v, uint32_t x)
+{
+    v += x * XXH32_P2;
+    v = _rotl32(v, 13);
+    return v * XXH32_P1;
+}
+
+// Mix a 4 byte word into xxHash
+static inline uint32_t _xxhash_word(uint32_t h, uint32_t x)
+{
+    h += x * XXH32_P3;
+    return _rotl32(h, 17) * XXH32_P4;
+}
+
+// Mix a single byte into xxHash
+static inline uint32_t _xxhash_byte(uint32_t h, uint32_t x)
+{
+    h += x * XXH32_P5;
+    return _rotl32(h, 11) * XXH32_P1;
+}
+
+// Finalize xxHash
+static inline uint32_t _xxhash_avalanche(uint32_t h)
+{
+    h ^= h >> 15;
+    h *= XXH32_P2;
+    h ^= h >> 13;
+    h *= XXH32_P3;
+    h ^= h >> 16;
+
+    return h;
+}
+
+// Process remaining bytes and finalize xxHash
+static inline uint32_t _xxhash_final(uint32_t h, const uint8_t* k, size_t length)
+{
+#define PROCESS1 h = _xxhash_byte(h, *k); k++;
+#define PROCESS2 h = _xxhash_word(h, _read32(k)); k += 4;
 
     switch (length & 15)
     {
@@ -284,11 +1090,888 @@ uint32_t hash_xxhashs(const void* key, size_t length, uint32_t seed)
         case 0:  break;
     }
 
-    h ^= h >> 15;
-    h *= p2;
-    h ^= h >> 13;
-    h *= p3;
-    h ^= h >> 16;
+#undef PROCESS1
+#undef PROCESS2
+
+    return _xxhash_avalanche(h);
+}
+
+// Compute 32-bit xxHash of inputs up to 16 bytes
+static inline uint32_t _xxhash_short(const uint8_t* k, size_t length, uint32_t seed)
+{
+    uint32_t h;
+
+    if (length == 16)
+    {
+        const uint32_t v1 = _xxhash_round(seed + XXH32_P1 + XXH32_P2, _read32(k));
+        const uint32_t v2 = _xxhash_round(seed + XXH32_P2, _read32(k + 4));
+        const uint32_t v3 = _xxhash_round(seed + 0, _read32(k + 8));
+        const uint32_t v4 = _xxhash_round(seed - XXH32_P1, _read32(k + 12));
+
+        h = _rotl32(v1, 1) + _rotl32(v2, 7) + _rotl32(v3, 12) + _rotl32(v4, 18);
+        return _xxhash_avalanche(h + 16);
+    }
+
+    // Remaining lengths jump straight to their unrolled word and byte steps
+    return _xxhash_final(seed + XXH32_P5 + (uint32_t) length, k, length);
+}
+
+// Compute 32-bit xxHash with constant seed
+uint32_t hash_xxhash(const void* key, size_t length)
+{
+    return hash_xxhashs(key, length, HASH_SEED);
+}
+
+// Compute 32-bit xxHash with seed
+uint32_t hash_xxhashs(const void* key, size_t length, uint32_t seed)
+{
+    const uint8_t* k = (const uint8_t*) key;
+    const uint8_t* end = k + length;
+
+    if (length <= 16) return _xxhash_short(k, length, seed);
+
+    const uint8_t* limit = end - 15;
+
+    uint32_t v1 = seed + XXH32_P1 + XXH32_P2;
+    uint32_t v2 = seed + XXH32_P2;
+    uint32_t v3 = seed + 0;
+    uint32_t v4 = seed - XXH32_P1;
+
+    do
+    {
+        v1 = _xxhash_round(v1, _read32(k)); k += 4;
+        v2 = _xxhash_round(v2, _read32(k)); k += 4;
+        v3 = _xxhash_round(v3, _read32(k)); k += 4;
+        v4 = _xxhash_round(v4, _read32(k)); k += 4;
+    } while (k < limit);
+
+    uint32_t h = _rotl32(v1, 1) + _rotl32(v2, 7) + _rotl32(v3, 12) + _rotl32(v4, 18);
+    h += (uint32_t) length;
+
+    return _xxhash_final(h, k, length);
+}
+
+// Initialize incremental 32-bit xxHash state with seed
+void hash_xxhash_init(hash_xxhash_state_t* state, uint32_t seed)
+{
+    state->v[0] = seed + XXH32_P1 + XXH32_P2;
+    state->v[1] = seed + XXH32_P2;
+    state->v[2] = seed + 0;
+    state->v[3] = seed - XXH32_P1;
+    state->seed = seed;
+    state->count = 0;
+    state->length = 0;
+}
+
+// Add bytes to incremental 32-bit xxHash state
+void hash_xxhash_update(hash_xxhash_state_t* state, const void* key, size_t length)
+{
+    const uint8_t* k = (const uint8_t*) key;
+    const uint8_t* end = k + length;
+
+    uint32_t v1 = state->v[0];
+    uint32_t v2 = state->v[1];
+    uint32_t v3 = state->v[2];
+    uint32_t v4 = state->v[3];
+
+    state->length += length;
+
+    // Complete previously buffered stripe
+    if (state->count)
+    {
+        const size_t fill = MIN(length, 16 - state->count);
+        memcpy(state->buffer + state->count, k, fill);
+        state->count += fill;
+        k += fill;
+
+        if (state->count < 16) return;
+
+        v1 = _xxhash_round(v1, _read32(state->buffer +  0));
+        v2 = _xxhash_round(v2, _read32(state->buffer +  4));
+        v3 = _xxhash_round(v3, _read32(state->buffer +  8));
+        v4 = _xxhash_round(v4, _read32(state->buffer + 12));
+        state->count = 0;
+    }
+
+    while (k + 16 <= end)
+    {
+        v1 = _xxhash_round(v1, _read32(k)); k += 4;
+        v2 = _xxhash_round(v2, _read32(k)); k += 4;
+        v3 = _xxhash_round(v3, _read32(k)); k += 4;
+        v4 = _xxhash_round(v4, _read32(k)); k += 4;
+    }
+
+    // Buffer remaining bytes for next update
+    state->count = end - k;
+    memcpy(state->buffer, k, state->count);
+
+    state->v[0] = v1;
+    state->v[1] = v2;
+    state->v[2] = v3;
+    state->v[3] = v4;
+}
+
+// Compute 32-bit xxHash of all bytes added to state
+uint32_t hash_xxhash_final(const hash_xxhash_state_t* state)
+{
+    uint32_t h = state->seed + XXH32_P5;
+
+    if (state->length >= 16)
+    {
+        h = _rotl32(state->v[0], 1) + _rotl32(state->v[1], 7) + _rotl32(state->v[2], 12) + _rotl32(state->v[3], 18);
+    }
+
+    h += (uint32_t) state->length;
+
+    return _xxhash_final(h, state->buffer, state->count);
+}
+
+
+// Process an 8 byte lane of 64-bit xxHash
+static inline uint64_t _xxhash64_round(uint64_t v, uint64_t x)
+{
+    v += x * XXH64_P2;
+    v = _rotl64(v, 31);
+    return v * XXH64_P1;
+}
+
+// Merge an 8 byte lane into 64-bit xxHash
+static inline uint64_t _xxhash64_merge(uint64_t h, uint64_t v)
+{
+    h ^= _xxhash64_round(0, v);
+    return h * XXH64_P1 + XXH64_P4;
+}
+
+// Compute 64-bit xxHash with constant seed
+uint64_t hash_xxhash64(const void* key, size_t length)
+{
+    return hash_xxhash64s(key, length, HASH_SEED);
+}
+
+// Compute 64-bit xxHash with seed
+uint64_t hash_xxhash64s(const void* key, size_t length, uint64_t seed)
+{
+    const uint8_t* k = (const uint8_t*) key;
+    const uint8_t* end = k + length;
+    uint64_t h;
+
+    if (length >= 32)
+    {
+        const uint8_t* limit = end - 32;
+
+        uint64_t v1 = seed + XXH64_P1 + XXH64_P2;
+        uint64_t v2 = seed + XXH64_P2;
+        uint64_t v3 = seed + 0;
+        uint64_t v4 = seed - XXH64_P1;
+
+        do
+        {
+            v1 = _xxhash64_round(v1, _read64(k)); k += 8;
+            v2 = _xxhash64_round(v2, _read64(k)); k += 8;
+            v3 = _xxhash64_round(v3, _read64(k)); k += 8;
+            v4 = _xxhash64_round(v4, _read64(k)); k += 8;
+        } while (k <= limit);
+
+        h = _rotl64(v1, 1) + _rotl64(v2, 7) + _rotl64(v3, 12) + _rotl64(v4, 18);
+        h = _xxhash64_merge(h, v1);
+        h = _xxhash64_merge(h, v2);
+        h = _xxhash64_merge(h, v3);
+        h = _xxhash64_merge(h, v4);
+    }
+    else
+    {
+        h = seed + XXH64_P5;
+    }
+
+    h += (uint64_t) length;
+
+    while (k + 8 <= end)
+    {
+        h ^= _xxhash64_round(0, _read64(k)); k += 8;
+        h = _rotl64(h, 27) * XXH64_P1 + XXH64_P4;
+    }
+
+    if (k + 4 <= end)
+    {
+        h ^= (uint64_t) _read32(k) * XXH64_P1; k += 4;
+        h = _rotl64(h, 23) * XXH64_P2 + XXH64_P3;
+    }
+
+    while (k < end)
+    {
+        h ^= (*k) * XXH64_P5; k++;
+        h = _rotl64(h, 11) * XXH64_P1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH64_P2;
+    h ^= h >> 29;
+    h *= XXH64_P3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+
+// Secret mixed into vectorized hash lanes
+static const uint64_t _vector_secret[32] =
+{
+    0x2CB0F69F4ABEA221ULL, 0x9417034723148989ULL, 0xDD555950609DFE03ULL, 0xDBAFB150DEB12800ULL,
+    0x7E789B2E6C442CB6ULL, 0xF41E5636C7E4F8C4ULL, 0x0959D150F8FBA7E4ULL, 0xA97316F13CDB9EEAULL,
+    0x74CD8258F9520068ULL, 0x55C74A62E116868BULL, 0xD2F4C799A2023CBDULL, 0xDF98CB79A37B51B9ULL,
+    0x396F5885524F3905ULL, 0xAF1D56386CA3B276ULL, 0xA9FFBE6B5104E85AULL, 0x6BD0C51B9FD533B3ULL,
+    0x980CE91C50AB4B56ULL, 0x28AC395780FE62C5ULL, 0x768912E3A6BCEDC7ULL, 0x50B3E8C9332C7C88ULL,
+    0xCE3BBFE520BD47DAULL, 0xCBA6C8E8E0BB7C4FULL, 0xBF194DB8434A346DULL, 0x7D8F2A7B60416D7FULL,
+    0x0849D1F6E0E10A5EULL, 0x7654B590D064E22FULL, 0x16D1DA9507DF3AF2ULL, 0xF63AEF1089EA30E4ULL,
+    0x9ADE6673CC6C522BULL, 0x4C75BC274E37087CULL, 0xD35E12B49F51F27BULL, 0x22DDF2FFCEE481EAULL,
+};
+
+// Object representing an instruction set specific vectorized hash kernel
+typedef struct
+{
+    const char* name;
+    int (*supported)(void);
+    void (*accumulate)(uint64_t* acc, const uint8_t* p, size_t nstripes, const uint64_t* secret);
+    void (*scramble)(uint64_t* acc, const uint64_t* secret);
+} _vector_kernel_t;
+
+static int _vector_supported_scalar(void)
+{
+    return 1;
+}
+
+// Accumulate 64 byte stripes into 8 lanes of 64-bit multiply results
+static void _vector_accumulate_scalar(uint64_t* acc, const uint8_t* p, size_t nstripes, const uint64_t* secret)
+{
+    for (size_t n = 0; n < nstripes; n++, p += HASH_VECTOR_STRIPE)
+    {
+        for (int i = 0; i < VECTOR_LANES; i++)
+        {
+            const uint64_t d = _read64(p + 8 * i);
+            const uint64_t dk = d ^ secret[n + i];
+
+            acc[i ^ 1] += d;
+            acc[i] += (dk & 0xFFFFFFFF) * (dk >> 32);
+        }
+    }
+}
+
+// Scramble lanes so that no input bits are lost between blocks
+static void _vector_scramble_scalar(uint64_t* acc, const uint64_t* secret)
+{
+    for (int i = 0; i < VECTOR_LANES; i++)
+    {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= secret[i];
+        acc[i] = a * XXH32_P1;
+    }
+}
+
+#ifdef HASH_X86
+static int _vector_supported_sse2(void)
+{
+    return __builtin_cpu_supports("sse2");
+}
+
+__attribute__((target("sse2")))
+static void _vector_accumulate_sse2(uint64_t* acc, const uint8_t* p, size_t nstripes, const uint64_t* secret)
+{
+    __m128i a[4];
+    for (int j = 0; j < 4; j++) a[j] = _mm_loadu_si128((const __m128i*) (acc + 2 * j));
+
+    for (size_t n = 0; n < nstripes; n++, p += HASH_VECTOR_STRIPE)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            const __m128i d = _mm_loadu_si128((const __m128i*) (p + 16 * j));
+            const __m128i dk = _mm_xor_si128(d, _mm_loadu_si128((const __m128i*) (secret + n + 2 * j)));
+            const __m128i product = _mm_mul_epu32(dk, _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1)));
+
+            a[j] = _mm_add_epi64(a[j], _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+            a[j] = _mm_add_epi64(a[j], product);
+        }
+    }
+
+    for (int j = 0; j < 4; j++) _mm_storeu_si128((__m128i*) (acc + 2 * j), a[j]);
+}
+
+__attribute__((target("sse2")))
+static void _vector_scramble_sse2(uint64_t* acc, const uint64_t* secret)
+{
+    const __m128i prime = _mm_set1_epi32(XXH32_P1);
+
+    for (int j = 0; j < 4; j++)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*) (acc + 2 * j));
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i*) (secret + 2 * j)));
+
+        const __m128i lo = _mm_mul_epu32(a, prime);
+        const __m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+        _mm_storeu_si128((__m128i*) (acc + 2 * j), _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+    }
+}
+
+static int _vector_supported_avx2(void)
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("avx2")))
+static void _vector_accumulate_avx2(uint64_t* acc, const uint8_t* p, size_t nstripes, const uint64_t* secret)
+{
+    __m256i a[2];
+    for (int j = 0; j < 2; j++) a[j] = _mm256_loadu_si256((const __m256i*) (acc + 4 * j));
+
+    for (size_t n = 0; n < nstripes; n++, p += HASH_VECTOR_STRIPE)
+    {
+        for (int j = 0; j < 2; j++)
+        {
+            const __m256i d = _mm256_loadu_si256((const __m256i*) (p + 32 * j));
+            const __m256i dk = _mm256_xor_si256(d, _mm256_loadu_si256((const __m256i*) (secret + n + 4 * j)));
+            const __m256i product = _mm256_mul_epu32(dk, _mm256_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1)));
+
+            a[j] = _mm256_add_epi64(a[j], _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+            a[j] = _mm256_add_epi64(a[j], product);
+        }
+    }
+
+    for (int j = 0; j < 2; j++) _mm256_storeu_si256((__m256i*) (acc + 4 * j), a[j]);
+}
+
+__attribute__((target("avx2")))
+static void _vector_scramble_avx2(uint64_t* acc, const uint64_t* secret)
+{
+    const __m256i prime = _mm256_set1_epi32(XXH32_P1);
+
+    for (int j = 0; j < 2; j++)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*) (acc + 4 * j));
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i*) (secret + 4 * j)));
+
+        const __m256i lo = _mm256_mul_epu32(a, prime);
+        const __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+        _mm256_storeu_si256((__m256i*) (acc + 4 * j), _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+    }
+}
+
+static int _vector_supported_avx512(void)
+{
+    return __builtin_cpu_supports("avx512f");
+}
+
+__attribute__((target("avx512f")))
+static void _vector_accumulate_avx512(uint64_t* acc, const uint8_t* p, size_t nstripes, const uint64_t* secret)
+{
+    __m512i a = _mm512_loadu_si512(acc);
+
+    for (size_t n = 0; n < nstripes; n++, p += HASH_VECTOR_STRIPE)
+    {
+        const __m512i d = _mm512_loadu_si512(p);
+        const __m512i dk = _mm512_xor_si512(d, _mm512_loadu_si512(secret + n));
+        const __m512i product = _mm512_mul_epu32(dk, _mm512_shuffle_epi32(dk, (_MM_PERM_ENUM) _MM_SHUFFLE(0, 3, 0, 1)));
+
+        a = _mm512_add_epi64(a, _mm512_shuffle_epi32(d, (_MM_PERM_ENUM) _MM_SHUFFLE(1, 0, 3, 2)));
+        a = _mm512_add_epi64(a, product);
+    }
+
+    _mm512_storeu_si512(acc, a);
+}
+
+__attribute__((target("avx512f")))
+static void _vector_scramble_avx512(uint64_t* acc, const uint64_t* secret)
+{
+    const __m512i prime = _mm512_set1_epi32(XXH32_P1);
+
+    __m512i a = _mm512_loadu_si512(acc);
+    a = _mm512_xor_si512(a, _mm512_srli_epi64(a, 47));
+    a = _mm512_xor_si512(a, _mm512_loadu_si512(secret));
+
+    const __m512i lo = _mm512_mul_epu32(a, prime);
+    const __m512i hi = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), prime);
+    _mm512_storeu_si512(acc, _mm512_add_epi64(lo, _mm512_slli_epi64(hi, 32)));
+}
+#endif
+
+// Kernels in order of preference
+static const _vector_kernel_t _vector_kernels[] =
+{
+#ifdef HASH_X86
+    { "avx512", _vector_supported_avx512, _vector_accumulate_avx512, _vector_scramble_avx512 },
+    { "avx2", _vector_supported_avx2, _vector_accumulate_avx2, _vector_scramble_avx2 },
+    { "sse2", _vector_supported_sse2, _vector_accumulate_sse2, _vector_scramble_sse2 },
+#endif
+    { "scalar", _vector_supported_scalar, _vector_accumulate_scalar, _vector_scramble_scalar },
+};
+
+static const _vector_kernel_t* _vector_selected = NULL;
+
+// Return selected kernel choosing the best supported one on first use
+static inline const _vector_kernel_t* _vector_kernel(void)
+{
+    const _vector_kernel_t* kernel = __atomic_load_n(&_vector_selected, __ATOMIC_ACQUIRE);
+
+    if (!kernel)
+    {
+        hash_vector_select(NULL);
+        kernel = __atomic_load_n(&_vector_selected, __ATOMIC_ACQUIRE);
+    }
+
+    return kernel;
+}
+
+// Initialize vectorized hash lanes with seed
+static inline void _vector_init(uint64_t* acc, uint64_t seed)
+{
+    acc[0] = XXH32_P3 + seed;
+    acc[1] = XXH64_P1 - seed;
+    acc[2] = XXH64_P2 + seed;
+    acc[3] = XXH64_P3 - seed;
+    acc[4] = XXH64_P4 + seed;
+    acc[5] = XXH32_P2 - seed;
+    acc[6] = XXH64_P5 + seed;
+    acc[7] = XXH32_P1 - seed;
+}
+
+// Multiply 64-bit numbers and fold 128-bit product
+static inline uint64_t _mul128_fold64(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+    const unsigned __int128 product = (unsigned __int128) a * b;
+    return (uint64_t) product ^ (uint64_t) (product >> 64);
+#else
+    // Schoolbook product of 32-bit halves where 128-bit integers are unavailable
+    const uint64_t lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    const uint64_t mid1 = (a >> 32) * (b & 0xFFFFFFFF);
+    const uint64_t mid2 = (a & 0xFFFFFFFF) * (b >> 32);
+    const uint64_t hi = (a >> 32) * (b >> 32);
+
+    const uint64_t cross = (lo >> 32) + (mid1 & 0xFFFFFFFF) + (mid2 & 0xFFFFFFFF);
+    return ((cross << 32) | (lo & 0xFFFFFFFF)) ^ (hi + (mid1 >> 32) + (mid2 >> 32) + (cross >> 32));
+#endif
+}
+
+// Merge vectorized hash lanes into 64-bit hash
+static inline uint64_t _vector_final(const uint64_t* acc, uint64_t length)
+{
+    const uint64_t* secret = _vector_secret + VECTOR_MERGE;
+    uint64_t h = length * XXH64_P1;
+
+    for (int i = 0; i < VECTOR_LANES; i += 2)
+    {
+        h += _mul128_fold64(acc[i] ^ secret[i], acc[i + 1] ^ secret[i + 1]);
+    }
+
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
 
     return h;
 }
+
+// Fold 64-bit hash to 32 bits
+static inline uint32_t _fold32(uint64_t h)
+{
+    return (uint32_t) (h ^ (h >> 32));
+}
+
+// Compute 32-bit vectorized long input hash with constant seed
+uint32_t hash_vector(const void* key, size_t length)
+{
+    return hash_vectors(key, length, HASH_SEED);
+}
+
+// Compute 32-bit vectorized long input hash with seed
+uint32_t hash_vectors(const void* key, size_t length, uint32_t seed)
+{
+    const uint8_t* k = (const uint8_t*) key;
+
+    // Inputs shorter than a stripe are not worth vectorizing
+    if (length < HASH_VECTOR_STRIPE) return _fold32(hash_xxhash64s(key, length, seed));
+
+    const _vector_kernel_t* kernel = _vector_kernel();
+
+    uint64_t acc[VECTOR_LANES];
+    _vector_init(acc, seed);
+
+    // Process every full block that is followed by more input
+    const size_t nblocks = (length - 1) / HASH_VECTOR_BLOCK;
+
+    for (size_t b = 0; b < nblocks; b++, k += HASH_VECTOR_BLOCK)
+    {
+        kernel->accumulate(acc, k, VECTOR_STRIPES, _vector_secret);
+        kernel->scramble(acc, _vector_secret + VECTOR_SCRAMBLE);
+    }
+
+    // Process remaining full stripes and the last (possibly overlapping) stripe
+    const size_t remaining = length - nblocks * HASH_VECTOR_BLOCK;
+    kernel->accumulate(acc, k, (remaining - 1) / HASH_VECTOR_STRIPE, _vector_secret);
+    kernel->accumulate(acc, k + remaining - HASH_VECTOR_STRIPE, 1, _vector_secret + VECTOR_LAST);
+
+    return _fold32(_vector_final(acc, length));
+}
+
+// Initialize incremental 32-bit vectorized hash state with seed
+void hash_vector_init(hash_vector_state_t* state, uint32_t seed)
+{
+    _vector_init(state->acc, seed);
+    state->seed = seed;
+    state->count = 0;
+    state->length = 0;
+}
+
+// Add bytes to incremental 32-bit vectorized hash state
+void hash_vector_update(hash_vector_state_t* state, const void* key, size_t length)
+{
+    const uint8_t* k = (const uint8_t*) key;
+    const uint8_t* end = k + length;
+    uint8_t* const pending = state->buffer + HASH_VECTOR_STRIPE;
+
+    state->length += length;
+
+    // Buffer input until a full block is followed by more input
+    if (state->count + length <= HASH_VECTOR_BLOCK)
+    {
+        memcpy(pending + state->count, k, length);
+        state->count += length;
+        return;
+    }
+
+    const _vector_kernel_t* kernel = _vector_kernel();
+
+    // Complete previously buffered block
+    if (state->count)
+    {
+        const size_t fill = HASH_VECTOR_BLOCK - state->count;
+        memcpy(pending + state->count, k, fill);
+        k += fill;
+
+        kernel->accumulate(state->acc, pending, VECTOR_STRIPES, _vector_secret);
+        kernel->scramble(state->acc, _vector_secret + VECTOR_SCRAMBLE);
+
+        memcpy(state->buffer, pending + HASH_VECTOR_BLOCK - HASH_VECTOR_STRIPE, HASH_VECTOR_STRIPE);
+        state->count = 0;
+    }
+
+    const uint8_t* start = k;
+
+    while (end - k > HASH_VECTOR_BLOCK)
+    {
+        kernel->accumulate(state->acc, k, VECTOR_STRIPES, _vector_secret);
+        kernel->scramble(state->acc, _vector_secret + VECTOR_SCRAMBLE);
+        k += HASH_VECTOR_BLOCK;
+    }
+
+    // Keep last processed stripe in front of pending bytes
+    if (k != start) memcpy(state->buffer, k - HASH_VECTOR_STRIPE, HASH_VECTOR_STRIPE);
+
+    state->count = end - k;
+    memcpy(pending, k, state->count);
+}
+
+// Compute 32-bit vectorized hash of all bytes added to state
+uint32_t hash_vector_final(const hash_vector_state_t* state)
+{
+    const uint8_t* pending = state->buffer + HASH_VECTOR_STRIPE;
+
+    if (state->length < HASH_VECTOR_STRIPE) return _fold32(hash_xxhash64s(pending, state->length, state->seed));
+
+    const _vector_kernel_t* kernel = _vector_kernel();
+
+    uint64_t acc[VECTOR_LANES];
+    memcpy(acc, state->acc, sizeof(acc));
+
+    // Last stripe may reach back into previously processed input
+    kernel->accumulate(acc, pending, (state->count - 1) / HASH_VECTOR_STRIPE, _vector_secret);
+    kernel->accumulate(acc, state->buffer + state->count, 1, _vector_secret + VECTOR_LAST);
+
+    return _fold32(_vector_final(acc, state->length));
+}
+
+// Return name of instruction set used by vectorized hash
+const char* hash_vector_isa(void)
+{
+    return _vector_kernel()->name;
+}
+
+// Select instruction set used by vectorized hash (NULL selects the best supported)
+int hash_vector_select(const char* isa)
+{
+    for (size_t i = 0; i < sizeof(_vector_kernels) / sizeof(_vector_kernels[0]); i++)
+    {
+        const _vector_kernel_t* kernel = &_vector_kernels[i];
+
+        if ((!isa || !strcmp(isa, kernel->name)) && kernel->supported())
+        {
+            __atomic_store_n(&_vector_selected, kernel, __ATOMIC_RELEASE);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+
+// Compute 32-bit xxHash of keys one at a time
+static void _xxhash_batch_scalar(const void* const* keys, const size_t* lengths, uint32_t* out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) out[i] = hash_xxhash(keys[i], lengths[i]);
+}
+
+// Compute 32-bit murmur3 hash of keys one at a time
+static void _murmur3_batch_scalar(const void* const* keys, const size_t* lengths, uint32_t* out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) out[i] = hash_murmur3(keys[i], lengths[i]);
+}
+
+#ifdef HASH_X86
+#define BATCH_ROTL(x, r) _mm256_or_si256(_mm256_slli_epi32(x, r), _mm256_srli_epi32(x, 32 - (r)))
+#define BATCH_BLEND(mask, x, y) _mm256_blendv_epi8(y, x, mask)
+
+// Load 4 bytes at offset from every lane whose mask is set
+__attribute__((target("avx2")))
+static inline __m256i _batch_gather32(__m256i lo, __m256i hi, __m256i offset, __m256i mask)
+{
+    const __m256i a = _mm256_add_epi64(lo, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(offset)));
+    const __m256i b = _mm256_add_epi64(hi, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(offset, 1)));
+
+    const __m128i x = _mm256_mask_i64gather_epi32(_mm_setzero_si128(), (const int*) 0, a, _mm256_castsi256_si128(mask), 1);
+    const __m128i y = _mm256_mask_i64gather_epi32(_mm_setzero_si128(), (const int*) 0, b, _mm256_extracti128_si256(mask, 1), 1);
+
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(x), y, 1);
+}
+
+// Load up to 3 trailing bytes of every lane into the low bytes of a word
+__attribute__((target("avx2")))
+static inline __m256i _batch_tail(const uint8_t* const* keys, const uint32_t* lengths)
+{
+    uint32_t tails[BATCH_LANES];
+
+    for (int i = 0; i < BATCH_LANES; i++)
+    {
+        const uint8_t* tail = keys[i] + (lengths[i] & ~3U);
+        const uint32_t n = lengths[i] & 3;
+        tails[i] = 0;
+
+        // Overlapping reads cover 1, 2 and 3 byte tails the same way
+        if (n) tails[i] = (tail[0] | (tail[n >> 1] << 8) | (tail[n - 1] << 16)) & ((1U << (8 * n)) - 1);
+    }
+
+    return _mm256_loadu_si256((const __m256i*) tails);
+}
+
+// Compute 32-bit xxHash of 8 keys at once in AVX2 lanes
+__attribute__((target("avx2")))
+static void _xxhash_batch8_avx2(const uint8_t* const* keys, const uint32_t* lengths, uint32_t* out)
+{
+    const __m256i p1 = _mm256_set1_epi32(XXH32_P1);
+    const __m256i p2 = _mm256_set1_epi32(XXH32_P2);
+    const __m256i p3 = _mm256_set1_epi32(XXH32_P3);
+    const __m256i p4 = _mm256_set1_epi32(XXH32_P4);
+    const __m256i p5 = _mm256_set1_epi32(XXH32_P5);
+    const __m256i seed = _mm256_set1_epi32(HASH_SEED);
+
+    const __m256i lo = _mm256_loadu_si256((const __m256i*) keys);
+    const __m256i hi = _mm256_loadu_si256((const __m256i*) (keys + 4));
+    const __m256i length = _mm256_loadu_si256((const __m256i*) lengths);
+    const __m256i nstripes = _mm256_srli_epi32(length, 4);
+
+    uint32_t stripes = 0;
+    for (int i = 0; i < BATCH_LANES; i++) stripes = MAX(stripes, lengths[i] >> 4);
+
+    __m256i v[4];
+    v[0] = _mm256_add_epi32(seed, _mm256_add_epi32(p1, p2));
+    v[1] = _mm256_add_epi32(seed, p2);
+    v[2] = seed;
+    v[3] = _mm256_sub_epi32(seed, p1);
+
+    __m256i offset = _mm256_setzero_si256();
+
+    // Process 16 byte stripes while any lane has one left
+    for (uint32_t s = 0; s < stripes; s++)
+    {
+        const __m256i mask = _mm256_cmpgt_epi32(nstripes, _mm256_set1_epi32(s));
+
+        for (int j = 0; j < 4; j++)
+        {
+            __m256i x = _batch_gather32(lo, hi, offset, mask);
+            x = _mm256_add_epi32(v[j], _mm256_mullo_epi32(x, p2));
+            x = _mm256_mullo_epi32(BATCH_ROTL(x, 13), p1);
+            v[j] = BATCH_BLEND(mask, x, v[j]);
+
+            offset = _mm256_add_epi32(offset, _mm256_set1_epi32(4));
+        }
+    }
+
+    // Lanes with long input merge their accumulators
+    __m256i h = _mm256_add_epi32(BATCH_ROTL(v[0], 1), BATCH_ROTL(v[1], 7));
+    h = _mm256_add_epi32(h, _mm256_add_epi32(BATCH_ROTL(v[2], 12), BATCH_ROTL(v[3], 18)));
+    h = BATCH_BLEND(_mm256_cmpgt_epi32(nstripes, _mm256_setzero_si256()), h, _mm256_add_epi32(seed, p5));
+    h = _mm256_add_epi32(h, length);
+
+    // Remaining 4 byte words
+    const __m256i nwords = _mm256_srli_epi32(_mm256_and_si256(length, _mm256_set1_epi32(15)), 2);
+    offset = _mm256_andnot_si256(_mm256_set1_epi32(15), length);
+
+    for (int j = 0; j < 3; j++)
+    {
+        const __m256i mask = _mm256_cmpgt_epi32(nwords, _mm256_set1_epi32(j));
+
+        __m256i x = _batch_gather32(lo, hi, offset, mask);
+        x = _mm256_add_epi32(h, _mm256_mullo_epi32(x, p3));
+        x = _mm256_mullo_epi32(BATCH_ROTL(x, 17), p4);
+        h = BATCH_BLEND(mask, x, h);
+
+        offset = _mm256_add_epi32(offset, _mm256_set1_epi32(4));
+    }
+
+    // Remaining bytes
+    const __m256i nbytes = _mm256_and_si256(length, _mm256_set1_epi32(3));
+    __m256i tail = _batch_tail(keys, lengths);
+
+    for (int j = 0; j < 3; j++)
+    {
+        const __m256i mask = _mm256_cmpgt_epi32(nbytes, _mm256_set1_epi32(j));
+
+        __m256i x = _mm256_and_si256(tail, _mm256_set1_epi32(0xFF));
+        x = _mm256_add_epi32(h, _mm256_mullo_epi32(x, p5));
+        x = _mm256_mullo_epi32(BATCH_ROTL(x, 11), p1);
+        h = BATCH_BLEND(mask, x, h);
+
+        tail = _mm256_srli_epi32(tail, 8);
+    }
+
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+    h = _mm256_mullo_epi32(h, p2);
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+    h = _mm256_mullo_epi32(h, p3);
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+
+    _mm256_storeu_si256((__m256i*) out, h);
+}
+
+// Compute 32-bit murmur3 hash of 8 keys at once in AVX2 lanes
+__attribute__((target("avx2")))
+static void _murmur3_batch8_avx2(const uint8_t* const* keys, const uint32_t* lengths, uint32_t* out)
+{
+    const __m256i c1 = _mm256_set1_epi32(MURMUR3_C1);
+    const __m256i c2 = _mm256_set1_epi32(MURMUR3_C2);
+
+    const __m256i lo = _mm256_loadu_si256((const __m256i*) keys);
+    const __m256i hi = _mm256_loadu_si256((const __m256i*) (keys + 4));
+    const __m256i length = _mm256_loadu_si256((const __m256i*) lengths);
+    const __m256i nblocks = _mm256_srli_epi32(length, 2);
+
+    uint32_t blocks = 0;
+    for (int i = 0; i < BATCH_LANES; i++) blocks = MAX(blocks, lengths[i] >> 2);
+
+    __m256i h = _mm256_set1_epi32(HASH_SEED);
+    __m256i offset = _mm256_setzero_si256();
+
+    // Process 4 byte blocks while any lane has one left
+    for (uint32_t b = 0; b < blocks; b++)
+    {
+        const __m256i mask = _mm256_cmpgt_epi32(nblocks, _mm256_set1_epi32(b));
+
+        __m256i k1 = _batch_gather32(lo, hi, offset, mask);
+        k1 = _mm256_mullo_epi32(k1, c1);
+        k1 = _mm256_mullo_epi32(BATCH_ROTL(k1, 15), c2);
+
+        __m256i x = BATCH_ROTL(_mm256_xor_si256(h, k1), 13);
+        x = _mm256_add_epi32(_mm256_mullo_epi32(x, _mm256_set1_epi32(5)), _mm256_set1_epi32(0xE6546B64));
+        h = BATCH_BLEND(mask, x, h);
+
+        offset = _mm256_add_epi32(offset, _mm256_set1_epi32(4));
+    }
+
+    // Remaining bytes (an empty tail mixes in zero)
+    __m256i k1 = _batch_tail(keys, lengths);
+    k1 = _mm256_mullo_epi32(k1, c1);
+    k1 = _mm256_mullo_epi32(BATCH_ROTL(k1, 15), c2);
+    h = _mm256_xor_si256(h, k1);
+
+    h = _mm256_xor_si256(h, length);
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x85EBCA6B));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0xC2B2AE35));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+
+    _mm256_storeu_si256((__m256i*) out, h);
+}
+
+// Split keys into groups of 8 short keys hashed in AVX2 lanes
+__attribute__((target("avx2")))
+static void _batch_avx2(void (*kernel)(const uint8_t* const*, const uint32_t*, uint32_t*), void (*scalar)(const void* const*, const size_t*, uint32_t*, size_t), const void* const* keys, const size_t* lengths, uint32_t* out, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + BATCH_LANES <= n; i += BATCH_LANES)
+    {
+        uint32_t group[BATCH_LANES];
+        int shorter = 1;
+
+        for (int j = 0; j < BATCH_LANES; j++)
+        {
+            shorter &= lengths[i + j] <= BATCH_MAX_LENGTH;
+            group[j] = (uint32_t) lengths[i + j];
+        }
+
+        // Long keys are faster with the scalar stripe loop
+        if (shorter) kernel((const uint8_t* const*) &keys[i], group, &out[i]);
+        else scalar(&keys[i], &lengths[i], &out[i], BATCH_LANES);
+    }
+
+    scalar(&keys[i], &lengths[i], &out[i], n - i);
+}
+
+__attribute__((target("avx2")))
+static void _xxhash_batch_avx2(const void* const* keys, const size_t* lengths, uint32_t* out, size_t n)
+{
+    _batch_avx2(_xxhash_batch8_avx2, _xxhash_batch_scalar, keys, lengths, out, n);
+}
+
+__attribute__((target("avx2")))
+static void _murmur3_batch_avx2(const void* const* keys, const size_t* lengths, uint32_t* out, size_t n)
+{
+    _batch_avx2(_murmur3_batch8_avx2, _murmur3_batch_scalar, keys, lengths, out, n);
+}
+
+#undef BATCH_ROTL
+#undef BATCH_BLEND
+#endif
+
+static void (*_xxhash_batch)(const void* const*, const size_t*, uint32_t*, size_t) = NULL;
+static void (*_murmur3_batch)(const void* const*, const size_t*, uint32_t*, size_t) = NULL;
+static pthread_once_t _batch_once = PTHREAD_ONCE_INIT;
+
+// Select batch implementations
+static void _batch_setup(void)
+{
+    _xxhash_batch = _xxhash_batch_scalar;
+    _murmur3_batch = _murmur3_batch_scalar;
+
+#ifdef HASH_X86
+    if (__builtin_cpu_supports("avx2"))
+    {
+        _xxhash_batch = _xxhash_batch_avx2;
+        _murmur3_batch = _murmur3_batch_avx2;
+    }
+#endif
+}
+
+// Compute 32-bit xxHash with constant seed of many keys at once
+void hash_xxhash_batch(const void* const* keys, const size_t* lengths, uint32_t* out, size_t n)
+{
+    pthread_once(&_batch_once, _batch_setup);
+    _xxhash_batch(keys, lengths, out, n);
+}
+
+// Compute 32-bit murmur3 hash with constant seed of many keys at once
+void hash_murmur3_batch(const void* const* keys, const size_t* lengths, uint32_t* out, size_t n)
+{
+    pthread_once(&_batch_once, _batch_setup);
+    _murmur3_batch(keys, lengths, out, n);
+}